@@ -0,0 +1,43 @@
+#version 330 core
+
+// Packed chunk vertex, see ChunkVertex.h
+layout (location = 0) in uvec2 aPacked;
+
+flat out vec2 tile;
+out vec2 tileCoord;
+out float light;
+out float fog_factor;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 transform;
+
+uniform float fogDensity;
+
+const float sideOffsets[3] = float[3](0.0f, 0.1428571492f, 0.8571428657f); // VertexSideOffset
+const float topOffsets[3] = float[3](0.0f, 0.9f, 0.05f); // VertexTopOffset
+
+void main() {
+	uint position = aPacked.x;
+	uint packedTexture = aPacked.y;
+
+	vec3 aPos = vec3(float(position & 31u), float((position >> 10) & 1023u), float((position >> 5) & 31u));
+	aPos.x += sideOffsets[(position >> 20) & 3u];
+	aPos.z += sideOffsets[(position >> 22) & 3u];
+	aPos.y += topOffsets[(position >> 24) & 3u];
+
+	uint atlasTile = packedTexture & 1023u;
+	tile = vec2(float(atlasTile % 32u), float(atlasTile / 32u));
+	tileCoord = vec2(float((packedTexture >> 10) & 31u), float((packedTexture >> 15) & 31u));
+	light = float(packedTexture >> 24) / 255.0f;
+	
+	vec4 posView = view * transform *  vec4(aPos, 1.0);
+	float fragDist = length(posView.xyz);
+	float curved = posView.y - 0.0008f * fragDist * fragDist;
+	posView.y = curved;
+	
+	fragDist = clamp(fragDist - 24.0f, 0.0f, 999.0f), 
+	fog_factor = clamp(fragDist * fogDensity, 0.0f, 1.0f);
+	
+	gl_Position = projection * posView;
+}
@@ -0,0 +1,87 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include "../src/ChunkThread.h"
+#include "../src/ChunkGenerator.h"
+
+/*
+Block property lookup benchmark, reads what the mesher needs of every block of generated chunks (render, transparency, model and face textures),
+once through the 'Block' objects of gamedata::blocks.indexer and once through the flat tables of BlockData. Then times remeshing the same area (see MeshBenchmark).
+Usage: BlockLookupBenchmark [radius] [passes], build it with -DBUILD_BENCHMARKS=ON.
+*/
+
+static unsigned long long lookUpByObjects(const unsigned short int* data, size_t blocks)
+{
+	unsigned long long sum = 0;
+	for (size_t i = 0; i < blocks; i++) {
+		const Block* block = gamedata::blocks.indexer[data[i]];
+		if (!block->isRenderable())
+			continue;
+		sum += block->hasTransparency() + block->getModelType();
+		for (int d = 0; d < 6; d++)
+			sum += block->getBlockTexture(d);
+	}
+	return sum;
+}
+
+static unsigned long long lookUpByTables(const unsigned short int* data, size_t blocks)
+{
+	unsigned long long sum = 0;
+	for (size_t i = 0; i < blocks; i++) {
+		unsigned short int block = data[i];
+		if (!gamedata::blocks.isRenderable(block))
+			continue;
+		sum += gamedata::blocks.hasTransparency(block) + gamedata::blocks.getModelType(block);
+		for (int d = 0; d < 6; d++)
+			sum += gamedata::blocks.getBlockTexture(block, d);
+	}
+	return sum;
+}
+
+// Best of 'passes' runs, in nanoseconds per block
+template <typename Lookup>
+static double timeLookups(Lookup lookup, const std::vector<unsigned short int>& data, int passes, unsigned long long& sum)
+{
+	double best = 0.0;
+	for (int pass = 0; pass < passes; pass++) {
+		auto start = std::chrono::steady_clock::now();
+		sum = lookup(data.data(), data.size());
+		double time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / data.size();
+		if (pass == 0 || time < best)
+			best = time;
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	int radius = argc > 1 ? atoi(argv[1]) : 2;
+	int passes = argc > 2 ? atoi(argv[2]) : 3;
+	if (radius < 1 || passes < 1) {
+		printf("usage: BlockLookupBenchmark [radius >= 1] [passes >= 1]\n");
+		return 1;
+	}
+
+	int seeds[16];
+	for (int i = 0; i < 16; i++)
+		seeds[i] = 1000003 * (i + 1) % 65536;
+	const int workers[CHUNK_STAGES] = { 0, 0, 0 };
+	chunk_thread::initManagerThread("bench", "", seeds, workers);
+
+	int side = radius * 2 + 1;
+	std::vector<unsigned short int> data((size_t)side * side * CHUNK_AREA * CHUNK_HEIGHT);
+	ChunkTimeStamp cts = { 0, 0, 600.0f };
+	for (int i = 0; i < side * side; i++)
+		generateChunk(&data[(size_t)i * CHUNK_AREA * CHUNK_HEIGHT], ChunkShape<CHUNK_SIZE, CHUNK_HEIGHT>(), (i / side - radius) * CHUNK_SIZE, (i % side - radius) * CHUNK_SIZE, cts);
+
+	unsigned long long object_sum, table_sum;
+	double by_objects = timeLookups(lookUpByObjects, data, passes, object_sum);
+	double by_tables = timeLookups(lookUpByTables, data, passes, table_sum);
+	printf("lookups  chunks: %d, block objects: %.2f ns per block, flat tables: %.2f ns per block (%.1fx)%s\n", side * side, by_objects, by_tables,
+		by_tables > 0.0 ? by_objects / by_tables : 0.0, object_sum == table_sum ? "" : ", RESULTS DIFFER");
+
+	MeshBenchmarkResult result = chunk_thread::benchmarkMeshing(radius, passes);
+	printf("remesh   chunks: %d, passes: %d, %.1f us per chunk\n", result.chunks, result.passes, result.microseconds_per_chunk);
+	return object_sum == table_sum ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <utility>
+#include "Headless.h"
+#include "../src/ChunkManager.h"
+
+/*
+Scripted flythrough of a new world: the player waits for the world around it, flies along +x for 8 s and then along +z for 4 s, 2 blocks per frame at 60 frames per second.
+Reports how many times each chunk got a mesh sent to the GPU (a new vertex array in the render list), ideally once, the mesh jobs run and the vertical sections meshed per meshed chunk.
+Flies twice, remeshing only the uncovered sections of the nearby chunks after a first mesh and all of them (see chunk_thread::setEdgeOnlyInvalidation()).
+Usage: FlythroughBenchmark [workers] [milliseconds per frame], build it with -DBUILD_BENCHMARKS=ON.
+*/
+static void flythrough(int workers, int frame_time)
+{
+	std::string datadir = headless::makeWorldDirectory("bench");
+	int render_distance = 8;
+	ChunkManager manager;
+	manager.initialize(datadir.c_str(), "bench", (render_distance * 2 + 1) * (render_distance * 2 + 1) * 3, render_distance, "flythrough", workers);
+	ChunkTimeStamp now = { 0, 5, 600.0f };
+	unsigned long long first_section = chunk_thread::getMeshedSections();
+
+	std::map<std::pair<int, int>, unsigned int> vertex_arrays; // Of each chunk in the render list
+	std::map<std::pair<int, int>, int> meshes;
+	int x = 8, z = 8;
+	for (int frame = 0; frame < 780; frame++) {
+		if (frame >= 60 && frame < 540)
+			x += 2;
+		else if (frame >= 540)
+			z += 2;
+		float yaw = frame < 540 ? 0.0f : 90.0f;
+		manager.updatePlayer(x, 100, z, yaw);
+		manager.update(now);
+		manager.updateRenderList(x, 100, z, yaw);
+
+		unsigned int vao;
+		int length, chunk_x, chunk_z;
+		while (!manager.getRenderInfoFor(vao, length, chunk_x, chunk_z)) {
+			unsigned int& known = vertex_arrays[{ chunk_x, chunk_z }];
+			if (known != vao) {
+				known = vao;
+				meshes[{ chunk_x, chunk_z }]++;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(frame_time));
+	}
+	unsigned long long mesh_jobs = chunk_thread::getStageRunTimes(STAGE_MESH)->getCount();
+	unsigned long long sections = chunk_thread::getMeshedSections() - first_section;
+	manager.destroy();
+
+	int times[6] = {}; // 1 to 5 and more
+	long total = 0;
+	for (const auto& chunk : meshes) {
+		total += chunk.second;
+		times[std::min(chunk.second, 6) - 1]++;
+	}
+	double chunks = meshes.empty() ? 1.0 : (double)meshes.size();
+	printf("  meshed chunks: %zu, meshes sent: %ld (%.2f per chunk), mesh jobs: %llu (%.2f per chunk), meshed sections: %llu (%.2f per chunk)\n", meshes.size(),
+		total, total / chunks, mesh_jobs, mesh_jobs / chunks, sections, sections / chunks);
+	printf("  chunks meshed once: %d, twice: %d, 3 times: %d, 4 times: %d, 5 times: %d, more: %d\n", times[0], times[1], times[2], times[3], times[4], times[5]);
+}
+
+int main(int argc, char** argv)
+{
+	int workers = argc > 1 ? atoi(argv[1]) : 0;
+	int frame_time = argc > 2 ? atoi(argv[2]) : 16;
+	if (workers < 0 || frame_time < 0) {
+		printf("usage: FlythroughBenchmark [workers, 0 for the default] [milliseconds per frame]\n");
+		return 1;
+	}
+
+	headless::installHeadlessGL();
+	for (int edge_only = 1; edge_only >= 0; edge_only--) {
+		printf("%s:\n", edge_only ? "uncovered sections of the nearby chunks remeshed" : "all sections of the nearby chunks remeshed");
+		chunk_thread::setEdgeOnlyInvalidation(edge_only);
+		flythrough(workers, frame_time);
+	}
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include "../src/ChunkThread.h"
+#include "../src/ChunkGenerator.h"
+
+/*
+Chunk generation benchmark, generates the chunks around chunk (0, 0) with their tickable blocks in two ways:
+recorded by generateChunk() as it places them, and found afterwards by a pass over every block with the id comparisons (how it was done before the tickable bits).
+Also checks that both find the same tickable blocks. Usage: GenerationBenchmark [radius] [passes], build it with -DBUILD_BENCHMARKS=ON.
+*/
+
+// The tickable blocks of 'data' from a pass over the whole chunk, in the order of the old pass (columns)
+static void findTickableBlocks(const unsigned short int* data, TickableBlockList* tickable_blocks)
+{
+	for (int x = 0; x < CHUNK_SIZE; x++) {
+		for (int z = 0; z < CHUNK_SIZE; z++) {
+			for (int y = 0; y < CHUNK_HEIGHT; y++) {
+				unsigned short int block = data[y * CHUNK_AREA + x * CHUNK_SIZE + z];
+				if (!gamedata::blocks.isTickableBlock(block))
+					continue;
+				TickableBlock tb = {};
+				tb.block_id = block;
+				tb.x = x;
+				tb.y = y;
+				tb.z = z;
+				tb.last_update.year = -1;
+				tickable_blocks->add(tb);
+			}
+		}
+	}
+}
+
+// Chunks per second, best of 'passes'
+static double timeGeneration(int radius, int passes, bool record, std::vector<TickableBlockList>& tickable_blocks)
+{
+	int side = radius * 2 + 1;
+	std::vector<unsigned short int> data(CHUNK_AREA * CHUNK_HEIGHT);
+	ChunkTimeStamp cts = { 0, 0, 600.0f };
+	double best = 0.0;
+	for (int pass = 0; pass < passes; pass++) {
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < side * side; i++) {
+			tickable_blocks[i].clear();
+			int base_x = (i / side - radius) * CHUNK_SIZE;
+			int base_z = (i % side - radius) * CHUNK_SIZE;
+			if (record)
+				generateChunk(data.data(), ChunkShape<CHUNK_SIZE, CHUNK_HEIGHT>(), base_x, base_z, cts, &tickable_blocks[i]);
+			else {
+				generateChunk(data.data(), ChunkShape<CHUNK_SIZE, CHUNK_HEIGHT>(), base_x, base_z, cts);
+				findTickableBlocks(data.data(), &tickable_blocks[i]);
+			}
+		}
+		double rate = side * side / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (rate > best)
+			best = rate;
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	int radius = argc > 1 ? atoi(argv[1]) : 5;
+	int passes = argc > 2 ? atoi(argv[2]) : 3;
+	if (radius < 0 || passes < 1) {
+		printf("usage: GenerationBenchmark [radius >= 0] [passes >= 1]\n");
+		return 1;
+	}
+
+	int seeds[16];
+	for (int i = 0; i < 16; i++)
+		seeds[i] = 1000003 * (i + 1) % 65536;
+	const int workers[CHUNK_STAGES] = { 0, 0, 0 };
+	chunk_thread::initManagerThread("bench", "", seeds, workers);
+
+	int chunks = (radius * 2 + 1) * (radius * 2 + 1);
+	std::vector<TickableBlockList> found(chunks), recorded(chunks);
+	double with_pass = timeGeneration(radius, passes, false, found);
+	double while_generating = timeGeneration(radius, passes, true, recorded);
+
+	size_t tickables = 0;
+	int mismatches = 0;
+	for (int i = 0; i < chunks; i++) {
+		tickables += found[i].size();
+		if (found[i].size() != recorded[i].size())
+			mismatches++;
+		for (TickableBlock* tb = found[i].begin(); tb != found[i].end(); ++tb) {
+			TickableBlock* other = recorded[i].find(tb->x, tb->y, tb->z);
+			if (!other || other->block_id != tb->block_id)
+				mismatches++;
+		}
+	}
+	printf("chunks: %d, tickable blocks: %zu, mismatches: %d\n", chunks, tickables, mismatches);
+	printf("pass over the chunk: %.0f chunks/s (%.2f ms per chunk)\n", with_pass, 1000.0 / with_pass);
+	printf("recorded while generating: %.0f chunks/s (%.2f ms per chunk)\n", while_generating, 1000.0 / while_generating);
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,70 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include "Headless.h"
+#include "../src/ChunkManager.h"
+
+/*
+ChunkManager::getBlock() benchmark, loads the chunks around the player at a few render distances (the memory chunks grow with the square of it) and times getBlock() calls:
+runs of calls in one chunk (like physics and raycasts) and calls spread over every loaded chunk. The cost should not grow with the memory chunks.
+Usage: GetBlockBenchmark [calls in millions], build it with -DBUILD_BENCHMARKS=ON.
+*/
+
+// Nanoseconds per call, reading 'calls' blocks from the chunks within 'distance' of chunk (0, 0), 'run' blocks of a chunk at a time
+static double timeGetBlock(ChunkManager& manager, long calls, int distance, int run, unsigned long long& sum)
+{
+	unsigned int random = 12345;
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < calls; i += run) {
+		random = random * 1103515245 + 12345;
+		int chunk_x = (int)(random >> 8) % (distance * 2 + 1) - distance;
+		int reach = distance - abs(chunk_x);
+		int chunk_z = (int)(random >> 20) % (reach * 2 + 1) - reach;
+		for (int b = 0; b < run; b++) {
+			unsigned short int block;
+			if (manager.getBlock(chunk_x * CHUNK_SIZE + (b & 15), 60 + (b >> 4 & 63), chunk_z * CHUNK_SIZE + (b >> 10 & 15), block))
+				sum += block;
+		}
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+}
+
+int main(int argc, char** argv)
+{
+	long calls = (long)((argc > 1 ? atof(argv[1]) : 4.0) * 1000000);
+	if (calls < 1024) {
+		printf("usage: GetBlockBenchmark [calls in millions]\n");
+		return 1;
+	}
+
+	headless::installHeadlessGL();
+	std::string datadir = headless::makeWorldDirectory("bench");
+	ChunkTimeStamp now = { 0, 5, 600.0f };
+	unsigned long long sum = 0;
+	for (int render_distance : { 2, 4, 8, 16 }) {
+		int memory_chunks = (render_distance * 2 + 1) * (render_distance * 2 + 1) * 3;
+		ChunkManager manager;
+		manager.initialize(datadir.c_str(), "bench", memory_chunks, render_distance, "benchmark");
+
+		// Everything within the render distance loaded
+		bool loaded = false;
+		while (!loaded) {
+			manager.updatePlayer(8, 100, 8);
+			manager.update(now);
+			manager.updateRenderList(8, 100, 8);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			loaded = true;
+			for (int x = -render_distance; x <= render_distance; x++)
+				for (int z = abs(x) - render_distance; z <= render_distance - abs(x); z++)
+					loaded = loaded && manager.chunkExists(x, z);
+		}
+
+		double one_chunk = timeGetBlock(manager, calls, render_distance, 1024, sum);
+		double spread = timeGetBlock(manager, calls, render_distance, 1, sum);
+		printf("memory chunks: %5d, runs in a chunk: %.2f ns per call, spread over the chunks: %.2f ns per call\n", memory_chunks, one_chunk, spread);
+		manager.destroy();
+	}
+	printf("(block sum %llu)\n", sum);
+	return 0;
+}
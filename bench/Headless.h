@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+/*
+Runs the chunk code without a window for the benchmarks and tests. installHeadlessGL() points the OpenGL functions of the chunk meshes to stubs which count the uploaded bytes,
+and glfwGetTime() is defined here, counting from one second before the program started (the chunk manager holds meshes back during the first second of a window).
+Include it in one source file of a program.
+*/
+namespace headless
+{
+	inline std::atomic<unsigned long long> vertex_bytes{ 0 }; // Sent to GL_ARRAY_BUFFER
+	inline std::atomic<unsigned long long> vertex_uploads{ 0 };
+	inline std::atomic<unsigned long long> index_bytes{ 0 }; // Sent to GL_ELEMENT_ARRAY_BUFFER
+	inline std::atomic<unsigned int> next_name{ 1 };
+
+	inline void APIENTRY genNames(GLsizei n, GLuint* names) {
+		for (GLsizei i = 0; i < n; i++)
+			names[i] = next_name++;
+	}
+
+	inline void APIENTRY deleteNames(GLsizei, const GLuint*) {}
+
+	inline void APIENTRY bindVertexArray(GLuint) {}
+
+	inline void APIENTRY bindBuffer(GLenum, GLuint) {}
+
+	inline void APIENTRY bufferData(GLenum target, GLsizeiptr size, const void*, GLenum) {
+		if (target == GL_ARRAY_BUFFER) {
+			vertex_bytes += size;
+			vertex_uploads++;
+		}
+		else if (target == GL_ELEMENT_ARRAY_BUFFER)
+			index_bytes += size;
+	}
+
+	inline void APIENTRY vertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) {}
+
+	inline void APIENTRY vertexAttribIPointer(GLuint, GLint, GLenum, GLsizei, const void*) {}
+
+	inline void APIENTRY enableVertexAttribArray(GLuint) {}
+
+	inline void installHeadlessGL() {
+		glad_glGenVertexArrays = genNames;
+		glad_glGenBuffers = genNames;
+		glad_glDeleteVertexArrays = deleteNames;
+		glad_glDeleteBuffers = deleteNames;
+		glad_glBindVertexArray = bindVertexArray;
+		glad_glBindBuffer = bindBuffer;
+		glad_glBufferData = bufferData;
+		glad_glVertexAttribPointer = vertexAttribPointer;
+		glad_glVertexAttribIPointer = vertexAttribIPointer;
+		glad_glEnableVertexAttribArray = enableVertexAttribArray;
+	}
+
+	// Makes an empty save directory for 'world_name' under the system temporary directory, returns it as the 'datadir' of ChunkManager::initialize()
+	inline std::string makeWorldDirectory(const char* world_name) {
+		std::filesystem::path datadir = std::filesystem::temp_directory_path() / "EndlessAdvantureHeadless";
+		std::filesystem::remove_all(datadir / world_name);
+		std::filesystem::create_directories(datadir / world_name);
+		return datadir.string() + "/";
+	}
+
+	inline const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+}
+
+extern "C" double glfwGetTime(void)
+{
+	return 1.0 + std::chrono::duration<double>(std::chrono::steady_clock::now() - headless::start).count();
+}
@@ -0,0 +1,31 @@
+#include <cstdio>
+#include <cstdlib>
+#include "../src/ChunkThread.h"
+
+/*
+Meshing microbenchmark, runs the chunk mesher on the calling thread without a window or OpenGL.
+Usage: MeshBenchmark [radius] [passes], build it with -DBUILD_BENCHMARKS=ON.
+*/
+int main(int argc, char** argv)
+{
+	int radius = argc > 1 ? atoi(argv[1]) : 4;
+	int passes = argc > 2 ? atoi(argv[2]) : 3;
+	if (radius < 1 || passes < 1) {
+		printf("usage: MeshBenchmark [radius >= 1] [passes >= 1]\n");
+		return 1;
+	}
+
+	int seeds[16];
+	for (int i = 0; i < 16; i++)
+		seeds[i] = 1000003 * (i + 1) % 65536;
+	const int workers[CHUNK_STAGES] = { 0, 0, 0 };
+	chunk_thread::initManagerThread("bench", "", seeds, workers);
+
+	for (int greedy = 1; greedy >= 0; greedy--) {
+		chunk_thread::setGreedyMeshing(greedy);
+		MeshBenchmarkResult result = chunk_thread::benchmarkMeshing(radius, passes);
+		printf("%-8s chunks: %d, passes: %d, vertices: %zu (%zu per chunk), vertex hash: %016llx, %.1f us per chunk\n", greedy ? "greedy" : "per-face",
+			result.chunks, result.passes, result.vertices, result.chunks ? result.vertices / result.chunks : 0, result.vertex_hash, result.microseconds_per_chunk);
+	}
+	return 0;
+}
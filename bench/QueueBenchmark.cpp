@@ -0,0 +1,104 @@
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../src/Queue.h"
+
+/*
+Queue<T> throughput benchmark against a std::deque behind a std::mutex, with the same interface.
+Producers enqueue pointer sized items, consumers take them one by one or in batches, reported in millions of items per second.
+Usage: QueueBenchmark [millions of items], build it with -DBUILD_BENCHMARKS=ON.
+*/
+
+template <typename T> class MutexQueue
+{
+public:
+
+	bool enqueue(const T& item) {
+		std::lock_guard<std::mutex> lock(mutex);
+		items.push_back(item);
+		return true;
+	}
+
+	int dequeueBatch(T* dst, int max_count) {
+		std::lock_guard<std::mutex> lock(mutex);
+		int count = 0;
+		while (count < max_count && !items.empty()) {
+			dst[count++] = items.front();
+			items.pop_front();
+		}
+		return count;
+	}
+
+private:
+
+	std::mutex mutex;
+
+	std::deque<T> items;
+
+};
+
+template <typename Q>
+static double throughput(Q& queue, int producers, int consumers, int batch, long long items)
+{
+	long long per_producer = items / producers;
+	std::atomic<long long> taken{ 0 };
+	std::atomic<long long> sum{ 0 };
+	std::vector<std::thread> threads;
+	auto start = std::chrono::steady_clock::now();
+	for (int p = 0; p < producers; p++) {
+		threads.emplace_back([&]() {
+			for (long long i = 0; i < per_producer; i++)
+				while (!queue.enqueue(i))
+					std::this_thread::yield();
+		});
+	}
+	for (int c = 0; c < consumers; c++) {
+		threads.emplace_back([&]() {
+			long long buffer[64];
+			long long local = 0;
+			while (taken.load(std::memory_order_relaxed) < per_producer * producers) {
+				int count = queue.dequeueBatch(buffer, batch);
+				if (count == 0) {
+					std::this_thread::yield();
+					continue;
+				}
+				for (int i = 0; i < count; i++)
+					local += buffer[i];
+				taken += count;
+			}
+			sum += local;
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (sum != producers * (per_producer * (per_producer - 1) / 2))
+		printf("WRONG SUM\n");
+	return per_producer * producers / seconds / 1000000.0;
+}
+
+int main(int argc, char** argv)
+{
+	long long items = (long long)((argc > 1 ? atof(argv[1]) : 2.0) * 1000000);
+	if (items < 1000) {
+		printf("usage: QueueBenchmark [millions of items]\n");
+		return 1;
+	}
+
+	const int threads[][2] = { { 1, 1 }, { 2, 2 }, { 4, 4 }, { 1, 4 }, { 4, 1 } };
+	for (const int* count : threads) {
+		for (int batch : { 1, 16 }) {
+			Queue<long long> ring(1024);
+			MutexQueue<long long> locked;
+			double ring_rate = throughput(ring, count[0], count[1], batch, items);
+			double mutex_rate = throughput(locked, count[0], count[1], batch, items);
+			printf("producers: %d, consumers: %d, batch: %2d, ring: %6.2f M/s, mutex: %6.2f M/s\n", count[0], count[1], batch, ring_rate, mutex_rate);
+		}
+	}
+	return 0;
+}
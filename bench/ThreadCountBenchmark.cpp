@@ -0,0 +1,65 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include "Headless.h"
+#include "../src/ChunkManager.h"
+
+/*
+Chunk worker benchmark, streams in a new world around the player with 1, 2, 4, ... chunk workers and reports the chunks generated and meshed per second.
+The workers are split by ChunkManager::initialize(): (n + 1) / 2 build, the rest mesh, plus CHUNK_IO_WORKERS for the files. The wait and run times of each stage show which one holds the others up.
+Usage: ThreadCountBenchmark [render distance] [most workers], build it with -DBUILD_BENCHMARKS=ON.
+*/
+
+static void printStage(const char* name, ChunkStage stage)
+{
+	const LatencyHistogram* wait = chunk_thread::getStageWaitTimes(stage);
+	const LatencyHistogram* run = chunk_thread::getStageRunTimes(stage);
+	printf("    %-5s jobs: %6llu, wait p50/p90: %7lld/%7lld us, run p50/p90: %6lld/%6lld us\n", name, run->getCount(),
+		wait->getPercentile(50.0f), wait->getPercentile(90.0f), run->getPercentile(50.0f), run->getPercentile(90.0f));
+}
+
+int main(int argc, char** argv)
+{
+	int render_distance = argc > 1 ? atoi(argv[1]) : 12;
+	int most_workers = argc > 2 ? atoi(argv[2]) : std::max(1, (int)std::thread::hardware_concurrency());
+	if (render_distance < 1 || most_workers < 1) {
+		printf("usage: ThreadCountBenchmark [render distance >= 1] [most workers >= 1]\n");
+		return 1;
+	}
+
+	headless::installHeadlessGL();
+	int memory_chunks = (render_distance * 2 + 1) * (render_distance * 2 + 1) * 3;
+	int in_range = render_distance * render_distance * 2 + render_distance * 2 + 1;
+	ChunkTimeStamp now = { 0, 5, 600.0f };
+	for (int workers = 1; ; workers = std::min(workers * 2, most_workers)) {
+		std::string datadir = headless::makeWorldDirectory("bench"); // Nothing saved, every chunk is generated
+		ChunkManager manager;
+		manager.initialize(datadir.c_str(), "bench", memory_chunks, render_distance, "benchmark", workers);
+
+		// Until every chunk within the render distance has a mesh
+		auto start = std::chrono::steady_clock::now();
+		int meshed = 0;
+		while (meshed < in_range) {
+			manager.updatePlayer(8, 100, 8);
+			manager.update(now);
+			manager.updateRenderList(8, 100, 8);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			size_t vertices;
+			manager.getMeshReport(meshed, vertices);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		unsigned long long built = chunk_thread::getStageRunTimes(STAGE_BUILD)->getCount();
+		unsigned long long meshes = chunk_thread::getStageRunTimes(STAGE_MESH)->getCount();
+		printf("workers: %2d (build %d, mesh %d, io %d), %d chunks in %.2f s: %.0f generated/s, %.0f meshed/s\n", workers, std::max(1, (workers + 1) / 2),
+			std::max(1, workers - std::max(1, (workers + 1) / 2)), CHUNK_IO_WORKERS, in_range, seconds, built / seconds, meshes / seconds);
+		printStage("io", STAGE_IO);
+		printStage("build", STAGE_BUILD);
+		printStage("mesh", STAGE_MESH);
+		manager.destroy();
+		if (workers == most_workers)
+			break;
+	}
+	return 0;
+}
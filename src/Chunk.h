@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
@@ -7,12 +9,28 @@
 
 #include "BlockTicks.h"
 #include "ChunkConstants.h"
-
+#include "GameData.h"
+#include "ChunkSection.h"
+#include "ChunkSnapshot.h"
+#include "ChunkVertex.h"
+#include "JobTicket.h"
+#include "MemoryPool.h"
+#include "TickableBlockList.h"
+
+/*
+One chunk slot of ChunkManager. Its state only moves forward, each step is taken by one side:
+- Free -> occupied: init() on the main thread.
+- Load requested (main) -> data available (build worker, loadRequestResponse()), or back to occupied (main, loadRequestCancelled()).
+- Mesh requested (main) -> new mesh ready (mesh worker) -> mesh uploaded (main, updateVRAM()).
+- Unload requested (main) -> free (IO worker, wipe() once the pins of nearby mesh jobs are gone). From the request on only that worker touches the slot.
+Flags read by the other side are atomics, setting one publishes what was written before it (the data, the mesh buffers).
+*/
 class Chunk
 {
 public:
 
 	void init(int chunk_x, int chunk_z) {
+		this->unload_requested = false;
 		this->occupied = true;
 		this->chunk_x = chunk_x;
 		this->chunk_z = chunk_z;
@@ -30,31 +48,22 @@ public:
 		if (verticalPieces) {
 			for (int i = 0; i < CHUNK_HEIGHT / CHUNK_SIZE; i++) {
 				if (verticalPieces[i]) {
-					delete[] verticalPieces[i];
+					MemoryPool::release(verticalPieces[i]);
 				}
 			}
-			delete[] verticalPieces;
-		}
-		if (verticalPiecesModified) {
-			delete[] verticalPiecesModified;
-		}
-		if (heights) {
-			delete[] heights;
+			MemoryPool::release(verticalPieces);
 		}
 		if (verticalPiecesSize) {
-			delete[] verticalPiecesSize;
-		}
-		if (light_heights) {
-			delete[] light_heights;
+			MemoryPool::release(verticalPiecesSize);
 		}
 		verticalPieces = nullptr;
-		verticalPiecesModified = nullptr;
-		heights = nullptr;
 		verticalPiecesSize = nullptr;
-		light_heights = nullptr;
 		deleteMesh();
 		deleteData();
-		data_modified = unload_requested = data_load_requested = mesh_update_requested = new_mesh_ready = false;
+		// 'unload_requested' stays set until init(), so the manager does not request another save while the slot is being freed
+		data_modified = data_load_requested = mesh_update_requested = new_mesh_ready = false;
+		dirty_sections = 0;
+		meshed_neighbors = 0;
 		chunk_x = chunk_z = vbo_length = max_height = 0;
 		in_render_range = 0;
 		vao = vbo = 0;
@@ -62,27 +71,43 @@ public:
 		occupied = false;
 	}
 
-	void loadRequestResponse(unsigned short int* data) {
-		this->data = data;
+	// Packs 'data' (CHUNK_AREA * CHUNK_HEIGHT blocks) into chunk sections, 'data' is not kept.
+	void loadRequestResponse(const unsigned short int* data) {
+		for (int i = 0; i < CHUNK_SECTIONS; i++)
+			sections[i] = ChunkSection::fromData(&data[i * CHUNK_SECTION_VOLUME]);
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			for (int z = 0; z < CHUNK_SIZE; z++) {
+				int column = x * CHUNK_SIZE + z;
+				height_map[column] = light_map[column] = -1;
+				for (int y = CHUNK_HEIGHT - 1; y >= 0; y--) {
+					if (updateColumnTop(column, y, data[y * CHUNK_AREA + column]))
+						break;
+				}
+			}
+		}
 		data_modified = false;
+		dirty_sections = ALL_SECTIONS; // First mesh
 		data_available = true;
 		data_load_requested = false;
 	}
 
+	// The load job was cancelled before it started (see chunk_thread::cancelLoadRequest()).
+	void loadRequestCancelled() {
+		data_load_requested = false;
+	}
+
 	void deleteData() {
 		data_available = false;
-		if (data) {
-			delete[] data;
-			data = nullptr;
+		for (int i = 0; i < CHUNK_SECTIONS; i++) {
+			ChunkSection* section = sections[i].exchange(nullptr);
+			if (section && !section->isShared())
+				delete section;
 		}
 		tickable_blocks.clear();
 	}
 
 	void meshRequestResponse() {
 		new_mesh_ready = true;
-		if (verticalPiecesModified)
-			for (int i = 0; i < CHUNK_HEIGHT / CHUNK_SIZE; i++)
-				verticalPiecesModified[i] = false;
 	}
 
 	// Need to be called from the same thread OpenGL initialized (Disable OpenGL calls with _activate_no_opengl_debug_mode(); USE ONLY FOR DEBUG)
@@ -99,16 +124,12 @@ public:
 
 		//if (size == 0); // Should be impossible, may be handled later
 
-		float* temp_buffer = new float[size];
+		ChunkVertex* temp_buffer = MemoryPool::allocateArray<ChunkVertex>(size);
 
 		int iterrator = 0;
 		for (int i = 0; i < CHUNK_HEIGHT / CHUNK_SIZE; i++) {
 			if (!verticalPiecesSize[i]) continue;
-			int src_size = size - iterrator;
-			if (src_size < verticalPiecesSize[i]) {
-				std::cout << "That's wierd" << std::endl;
-			}
-			memcpy(&temp_buffer[iterrator], verticalPieces[i], verticalPiecesSize[i] * sizeof(float));
+			memcpy(&temp_buffer[iterrator], verticalPieces[i], verticalPiecesSize[i] * sizeof(ChunkVertex));
 			iterrator += verticalPiecesSize[i];
 		}
 
@@ -120,16 +141,12 @@ public:
 
 		glGenBuffers(1, &vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, vbo_length * sizeof(float), temp_buffer, GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vbo_length * sizeof(ChunkVertex), temp_buffer, GL_STATIC_DRAW);
 
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+		glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(ChunkVertex), (void*)0);
 		glEnableVertexAttribArray(0);
 
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-		glEnableVertexAttribArray(1);
-
-		glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(5 * sizeof(float)));
-		glEnableVertexAttribArray(2);
+		bindQuadIndices(vbo_length / 4); // Part of the VAO
 
 		glBindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -137,7 +154,7 @@ public:
 		this->vbo_length = vbo_length;
 
 		// Delete & Finalize
-		delete[] temp_buffer;
+		MemoryPool::release(temp_buffer);
 		temp_buffer = nullptr;
 		mesh_available = true;
 		new_mesh_ready = false;
@@ -186,13 +203,9 @@ public:
 		return unload_requested;
 	}
 
+	// True if any vertical section needs a new mesh.
 	bool isDataUpdated() {
-		if(verticalPiecesModified)
-			for (int i = 0; i < CHUNK_HEIGHT / CHUNK_SIZE; i++)
-				if (verticalPiecesModified[i]) return true;
-		if (data_available && !verticalPiecesModified)
-			return true;
-		return false;
+		return dirty_sections != 0;
 	}
 
 	bool isDataModified() {
@@ -203,14 +216,38 @@ public:
 		data_load_requested = true;
 	}
 
-	void setMeshUpdateRequested() {
+	void setMeshUpdateRequested(bool urgent = false) {
 		mesh_update_requested = true;
+		mesh_request_urgent = urgent;
+	}
+
+	// The mesh request was queued on the urgent lane.
+	bool isMeshRequestUrgent() {
+		return mesh_request_urgent;
 	}
 
 	void setUnloadRequested() {
 		unload_requested = true;
 	}
 
+	// Pinned chunks are being read by a mesh job of a nearby chunk. Fails if an unload is already requested.
+	bool pin() {
+		pins++;
+		if (unload_requested) {
+			pins--;
+			return false;
+		}
+		return true;
+	}
+
+	void unpin() {
+		pins--;
+	}
+
+	bool isPinned() {
+		return pins > 0;
+	}
+
 	int getChunkX() {
 		return chunk_x;
 	}
@@ -222,21 +259,114 @@ public:
 	bool getLocalBlock(int x, int y, int z, unsigned short int& block) {
 		if (x < 0 || x >= CHUNK_SIZE || y < 0 || y >= CHUNK_HEIGHT || z < 0 || z >= CHUNK_SIZE || !data_available)
 			return false;
-		int index = y * CHUNK_AREA + x * CHUNK_SIZE + z;
-		block = data[index];
+		block = sections[y / CHUNK_SIZE].load()->getBlock((y % CHUNK_SIZE) * CHUNK_AREA + x * CHUNK_SIZE + z);
 		return true;
 	}
 
-	// Does not include tickable_blocks checking.
+	// Does not include tickable_blocks checking. Main thread only.
 	bool setLocalBlock(int x, int y, int z, unsigned short int block) {
 		if (x < 0 || x >= CHUNK_SIZE || y < 0 || y >= CHUNK_HEIGHT || z < 0 || z >= CHUNK_SIZE || !data_available)
 			return false;
-		int index = y * CHUNK_AREA + x * CHUNK_SIZE + z;
-		data[index] = block;
+		int index = (y % CHUNK_SIZE) * CHUNK_AREA + x * CHUNK_SIZE + z;
+		ChunkSection* section = sections[y / CHUNK_SIZE];
+		if (section->isShared()) {
+			if (section->getUniformBlock() != block) {
+				// First write into a shared section, it gets its own copy. The shared one stays valid for any reader.
+				ChunkSection* own = new ChunkSection(section->getUniformBlock());
+				own->setBlock(index, block);
+				sections[y / CHUNK_SIZE] = own;
+			}
+		}
+		else if (section->beginWrite()) {
+			section->setBlock(index, block);
+			section->endWrite();
+		}
+		else {
+			// A mesh job holds the section, it keeps reading the old one
+			ChunkSection* copy = section->clone();
+			copy->setBlock(index, block);
+			sections[y / CHUNK_SIZE] = copy;
+			ChunkSection::retire(section);
+		}
+
+		// Keep the column heights. Only removing the top block of a column needs a scan, and it stops at the first opaque block.
+		int column = x * CHUNK_SIZE + z;
+		if (y == height_map[column] || y == light_map[column]) {
+			int top = height_map[column] > y ? height_map[column].load() : y;
+			height_map[column] = light_map[column] = -1;
+			unsigned short int tempb = 0;
+			for (int ty = top; ty >= 0; ty--) {
+				getLocalBlock(x, ty, z, tempb);
+				if (updateColumnTop(column, ty, tempb))
+					break;
+			}
+		}
+		else {
+			updateColumnTop(column, y, block);
+		}
+
+		section_versions[y / CHUNK_SIZE]++; // After the column heights, a snapshot taken before any of it sees the change
 		data_modified = true;
 		return true;
 	}
 
+	// For mesh jobs: holds the chunk's sections and copies the column heights, see ChunkSnapshot. The data must be available.
+	void takeSnapshot(ChunkSnapshot& snapshot) {
+		for (int i = 0; i < CHUNK_SECTIONS; i++) {
+			snapshot.versions[i] = section_versions[i];
+			ChunkSection* section;
+			for (;;) {
+				section = sections[i];
+				if (section->isShared())
+					break;
+				section->acquire();
+				if (sections[i] == section) {
+					section->waitForWriter();
+					break;
+				}
+				section->release(); // Replaced meanwhile, hold the new one
+			}
+			snapshot.sections[i] = section;
+		}
+		for (int i = 0; i < CHUNK_AREA; i++) {
+			snapshot.height_map[i] = height_map[i].load(std::memory_order_relaxed);
+			snapshot.light_map[i] = light_map[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	void releaseSnapshot(ChunkSnapshot& snapshot) {
+		for (int i = 0; i < CHUNK_SECTIONS; i++)
+			if (!snapshot.sections[i]->isShared())
+				snapshot.sections[i]->release();
+	}
+
+	// Bit n is set if section n was written since 'snapshot' was taken, a mesh made from it is stale there.
+	unsigned int getSectionsChangedSince(const ChunkSnapshot& snapshot) {
+		unsigned int changed = 0;
+		for (int i = 0; i < CHUNK_SECTIONS; i++)
+			if (section_versions[i] != snapshot.versions[i])
+				changed |= 1u << i;
+		return changed;
+	}
+
+	// Highest renderable block in column (x, z), -1 if there is none.
+	int getColumnHeight(int x, int z) {
+		return height_map[x * CHUNK_SIZE + z];
+	}
+
+	// Highest renderable block without transparency in column (x, z), blocks below it are in shadow. -1 if there is none.
+	int getColumnLightHeight(int x, int z) {
+		return light_map[x * CHUNK_SIZE + z];
+	}
+
+	// True if every block of vertical section 'section' is 'block'. Constant time, sections written since load may not be reported.
+	bool isSectionUniform(int section, unsigned short int& block) {
+		if (section < 0 || section >= CHUNK_SECTIONS || !data_available || !sections[section].load()->isUniform())
+			return false;
+		block = sections[section].load()->getUniformBlock();
+		return true;
+	}
+
 	bool getRenderInfo(int& vbo_len, unsigned int& vao) {
 		if (!mesh_available) return false;
 		vbo_len = vbo_length;
@@ -284,44 +414,82 @@ public:
 		data_modified = true;
 	}
 
-	// Careful with this
-	unsigned short int* getDataPointer() {
-		return data;
+	// Writes the whole chunk data (CHUNK_AREA * CHUNK_HEIGHT blocks) to 'dst' in flat layer order.
+	void copyData(unsigned short int* dst) {
+		for (int i = 0; i < CHUNK_SECTIONS; i++)
+			sections[i].load()->unpack(&dst[i * CHUNK_SECTION_VOLUME]);
+	}
+
+	// Heap bytes used by the chunk's block data (sections, palettes and indices).
+	size_t getMemoryUsage() {
+		size_t bytes = 0;
+		for (int i = 0; i < CHUNK_SECTIONS; i++)
+			if (sections[i])
+				bytes += sections[i].load()->getMemoryUsage();
+		return bytes;
+	}
+
+	// Vertices of the mesh in VRAM, 0 without one.
+	int getVertexCount() {
+		return mesh_available ? vbo_length : 0;
 	}
 
 	// Vector of tickable blocks
-	std::vector<TickableBlock>* getTickableBlocksPointer() {
+	TickableBlockList* getTickableBlocksPointer() {
 		return &tickable_blocks;
 	}
 
 	void setUpdateNeededInLayer(int layer) {
-		if (verticalPiecesModified && layer >= 0 && layer < CHUNK_HEIGHT / CHUNK_SIZE)
-			verticalPiecesModified[layer] = true;
+		if (layer >= 0 && layer < CHUNK_SECTIONS)
+			dirty_sections |= 1u << layer;
+	}
+
+	// Called by the first mesh job of the nearby chunk on side 'nearby' (one of NEARBY_*), 'sections' are the vertical sections whose faces on that side it uncovers.
+	// The next mesh job remeshes those sections, unless the mesh was already made with that chunk.
+	void nearbyChunkLoaded(unsigned int nearby, unsigned int sections) {
+		if (!(meshed_neighbors & nearby))
+			dirty_sections |= sections & ALL_SECTIONS;
+	}
+
+	// Mesh jobs clear these before looking at the nearby chunks and add the ones they could read, see nearbyChunkLoaded().
+	// A nearby chunk which shows up in between either is seen by the mesh job or finds its bit cleared.
+	void clearMeshedNeighbors() {
+		meshed_neighbors = 0;
+	}
+
+	void addMeshedNeighbors(unsigned int nearby) {
+		meshed_neighbors |= nearby;
 	}
 
 	void setUpdateNeededInAll() {
-		if (!verticalPiecesModified) return;
-		for (int layer = 0; layer < /*max_height*/ CHUNK_HEIGHT / CHUNK_SIZE; layer++)
-			verticalPiecesModified[layer] = true;
+		dirty_sections = ALL_SECTIONS;
 	}
 
-	float**& _verticalChunkData() {
-		return verticalPieces;
+	// Bit n is set if vertical section n needs a new mesh. Taken by the mesh job when it starts, so updates marked while it runs are kept for the next one.
+	unsigned int takeDirtySections() {
+		return dirty_sections.exchange(0);
 	}
 
-	bool*& _verticalChunkModified() {
-		return verticalPiecesModified;
+	// Sides of the nearby chunks, for nearbyChunkLoaded() and addMeshedNeighbors()
+	static const unsigned int NEARBY_XN = 1;
+	static const unsigned int NEARBY_XP = 2;
+	static const unsigned int NEARBY_ZN = 4;
+	static const unsigned int NEARBY_ZP = 8;
+
+	// Tickets of the queued load and mesh jobs, see JobTicket
+	JobTicket* getLoadTicket() {
+		return &load_ticket;
 	}
 
-	int*& _heights() {
-		return heights;
+	JobTicket* getMeshTicket() {
+		return &mesh_ticket;
 	}
 
-	int*& _light_heights() {
-		return light_heights;
+	ChunkVertex**& _verticalChunkData() {
+		return verticalPieces;
 	}
 
-	int*& _verticalChunkSize() { // Mesh Data Buffer Size
+	int*& _verticalChunkSize() { // Mesh Data Buffer Size (vertices)
 		return verticalPiecesSize;
 	}
 
@@ -333,23 +501,39 @@ public:
 
 private:
 
-	bool occupied = false;
+	std::atomic<bool> occupied{ false };
 
-	bool data_available = false;
+	std::atomic<bool> data_available{ false };
 
-	bool data_load_requested = false;
+	std::atomic<bool> data_load_requested{ false };
 
 	//bool data_updated = false; // This means if data was updated and a mesh request may be needed
 
-	bool data_modified = false; // This means if the data modified since load/generate
+	std::atomic<bool> data_modified{ false }; // This means if the data modified since load/generate
 
 	bool mesh_available = false;
 
-	bool mesh_update_requested = false;
+	std::atomic<bool> mesh_update_requested{ false };
+
+	bool mesh_request_urgent = false;
+
+	std::atomic<bool> new_mesh_ready{ false };
+
+	std::atomic<bool> unload_requested{ false };
+
+	std::atomic<int> pins{ 0 };
 
-	bool new_mesh_ready = false;
+	static_assert(CHUNK_SECTIONS <= 32, "dirty_sections has one bit per vertical section");
 
-	bool unload_requested = false;
+	static const unsigned int ALL_SECTIONS = ~0u >> (32 - CHUNK_SECTIONS);
+
+	std::atomic<unsigned int> dirty_sections{ 0 };
+
+	std::atomic<unsigned int> meshed_neighbors{ 0 }; // NEARBY_* bits of the nearby chunks the last mesh job read
+
+	JobTicket load_ticket;
+
+	JobTicket mesh_ticket;
 
 	Chunk* tmp_xn;
 
@@ -361,30 +545,71 @@ private:
 
 	int in_render_range;
 
-	int chunk_x = 0;
+	std::atomic<int> chunk_x{ 0 };
+
+	std::atomic<int> chunk_z{ 0 };
 
-	int chunk_z = 0;
+	std::atomic<ChunkSection*> sections[CHUNK_SECTIONS] = {}; // Replaced by the main thread (copy on write), see takeSnapshot()
 
-	unsigned short int* data = nullptr;
+	std::atomic<unsigned int> section_versions[CHUNK_SECTIONS] = {}; // Counts the writes into each section
 
 	unsigned int vao = 0;
 
 	unsigned int vbo = 0;
 
-	int vbo_length = 0;
+	int vbo_length = 0; // Vertices, 4 per quad
 
 	int max_height = 0;
 
-	std::vector<TickableBlock> tickable_blocks;
+	TickableBlockList tickable_blocks;
 
-	float** verticalPieces = nullptr;
+	ChunkVertex** verticalPieces = nullptr;
 
-	bool* verticalPiecesModified = nullptr;
+	int* verticalPiecesSize = nullptr;
 
-	int* heights = nullptr;
+	// Column tops, index is (x * CHUNK_SIZE) + z. See getColumnHeight() and getColumnLightHeight().
+	std::atomic<short int> height_map[CHUNK_AREA]; // Written by the main thread, copied by mesh jobs
 
-	int* light_heights = nullptr;
+	std::atomic<short int> light_map[CHUNK_AREA];
 
-	int* verticalPiecesSize = nullptr;
+	// Raises the column tops if 'block' at 'y' is above them. Returns true once the column has an opaque top (nothing below can change it).
+	bool updateColumnTop(int column, int y, unsigned short int block) {
+		if (!gamedata::blocks.isRenderable(block))
+			return false;
+		if (height_map[column] < y)
+			height_map[column] = y;
+		if (gamedata::blocks.hasTransparency(block))
+			return false;
+		if (light_map[column] < y)
+			light_map[column] = y;
+		return true;
+	}
+
+	// Binds the index buffer shared by every chunk mesh, for at least 'quads' quads. Quad i is vertices 4i to 4i + 3, drawn as the triangles 0 1 2 and 0 3 1.
+	// Grown when a mesh needs more, the VAOs holding it see the new storage. Needs the OpenGL thread like updateVRAM().
+	static void bindQuadIndices(int quads) {
+		static unsigned int ebo = 0;
+		static int capacity = 0;
+		if (!ebo)
+			glGenBuffers(1, &ebo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+		if (quads <= capacity)
+			return;
+		if (!capacity)
+			capacity = 4096;
+		while (capacity < quads)
+			capacity *= 2;
+		std::vector<unsigned int> indices(capacity * 6);
+		for (int i = 0; i < capacity; i++) {
+			unsigned int first = i * 4;
+			indices[i * 6 + 0] = first;
+			indices[i * 6 + 1] = first + 1;
+			indices[i * 6 + 2] = first + 2;
+			indices[i * 6 + 3] = first;
+			indices[i * 6 + 4] = first + 3;
+			indices[i * 6 + 5] = first + 1;
+		}
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	}
 
 };
@@ -5,5 +5,62 @@
 #define CHUNK_HEIGHT 512
 #define CHUNK_AREA CHUNK_SIZE * CHUNK_SIZE
 
+/*
+Chunk dimensions as a type. Kernels written against a shape (generator, file codec) are compiled for each shape with constant loop bounds and strides.
+ChunkShape<0, 0> carries the dimensions at runtime, for sizes that have no compiled kernel.
+Chunk storage and the mesher are not written against a shape yet, they use CHUNK_SIZE and CHUNK_HEIGHT.
+*/
+template <int Size, int Height>
+struct ChunkShape
+{
+	static constexpr int size() { return Size; }
+	static constexpr int height() { return Height; }
+	static constexpr int area() { return Size * Size; }
+	static constexpr int volume() { return Size * Size * Height; }
+};
+
+template <>
+struct ChunkShape<0, 0>
+{
+	ChunkShape(int size, int height) : chunk_size(size), chunk_height(height) {}
+
+	int size() const { return chunk_size; }
+	int height() const { return chunk_height; }
+	int area() const { return chunk_size * chunk_size; }
+	int volume() const { return chunk_size * chunk_size * chunk_height; }
+
+	int chunk_size;
+	int chunk_height;
+};
+
+// Calls 'kernel' with the compiled shape for (size, height): 16x512 (the game's chunks), 16x256 (shallow worlds) or 32x32 (cubic), else with ChunkShape<0, 0>.
+template <typename Kernel>
+auto withChunkShape(int size, int height, Kernel kernel) {
+	if (size == 16 && height == 512) return kernel(ChunkShape<16, 512>());
+	if (size == 16 && height == 256) return kernel(ChunkShape<16, 256>());
+	if (size == 32 && height == 32) return kernel(ChunkShape<32, 32>());
+	return kernel(ChunkShape<0, 0>(size, height));
+}
+
+// Chunk data is stored in vertical sections of CHUNK_SIZE^3 blocks.
+#define CHUNK_SECTIONS (CHUNK_HEIGHT / CHUNK_SIZE)
+#define CHUNK_SECTION_VOLUME (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+
+// Vertices (ChunkVertex) in the chunk thread's mesh scratch buffers (one vertical section, solid and liquid parts)
+#define MESH_BUFFER_SIZE 16384
+#define MESH_LIQUID_BUFFER_SIZE 4096
+
+// Mesh jobs merge next to each other faces of the same block and light into larger quads, see chunk_thread::setGreedyMeshing()
+#define CHUNK_GREEDY_MESHING true
+
+// Chunk workers reading and saving chunk files (see ChunkStage). Mostly waiting for the disk, so they are not counted as the generation and meshing workers.
+#define CHUNK_IO_WORKERS 2
+
+// Chunks are loaded this many chunks past the render distance but not meshed, so every meshed chunk has all four nearby chunks loaded.
+#define CHUNK_LOAD_MARGIN 1
+
+// Load and mesh requests given to the chunk workers at once, per worker. The rest wait in the manager, so they can be reordered as the player moves.
+#define REQUESTS_IN_FLIGHT_PER_WORKER 8
+
 // When there are less than this number of free chunks, delete out of view chunks from memory.
-#define DELETE_CHUNKS_THRESHOLD 20
\ No newline at end of file
+#define DELETE_CHUNKS_THRESHOLD 20
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 #include <string>
 
 #include "BlockTicks.h"
+#include "ChunkConstants.h"
+#include "MemoryPool.h"
 
 class ChunkDataFile 
 {
@@ -18,6 +21,12 @@ public:
 
 	// Writes the chunk data into storage ('data' size is not being checked in the method, be aware).
 	bool saveChunkData(unsigned short int* data, int chunk_x, int chunk_z, int chunk_size, int chunk_height) {
+		return withChunkShape(chunk_size, chunk_height, [&](auto shape) { return saveChunkData(data, chunk_x, chunk_z, shape); });
+	}
+
+	// Same as above, with the dimensions given by a ChunkShape.
+	template <typename Shape>
+	bool saveChunkData(unsigned short int* data, int chunk_x, int chunk_z, Shape shape) {
 
 		if (!folder_availabe) return false;
 
@@ -32,7 +41,8 @@ public:
 
 		if (fp == nullptr) return false;
 
-		int area = chunk_size * chunk_size;
+		const int area = shape.area();
+		const int chunk_height = shape.height();
 
 		ChunkHeader ch;
 		ch.x = chunk_x;
@@ -83,78 +93,96 @@ public:
 
 	// Loads the chunk data from the storage ('data' size is not being checked in the method, be aware).
 	bool loadChunkData(unsigned short int* data, int chunk_x, int chunk_z, int chunk_size, int chunk_height) {
+		return withChunkShape(chunk_size, chunk_height, [&](auto shape) { return loadChunkData(data, chunk_x, chunk_z, shape); });
+	}
 
-		int area = chunk_size * chunk_size;
+	// Same as above, with the dimensions given by a ChunkShape.
+	template <typename Shape>
+	bool loadChunkData(unsigned short int* data, int chunk_x, int chunk_z, Shape shape) {
+		size_t size = 0;
+		unsigned char* bytes = readChunkData(chunk_x, chunk_z, size);
+		bool loaded = decodeChunkData(bytes, size, data, shape);
+		MemoryPool::release(bytes);
+		return loaded;
+	}
 
-		for (int i = 0; i < area * chunk_height; i++) {
-			data[i] = 65535;
-		}
+	// Loads tickable blocks (Allocates data, call 'delete[] buffer;' after you are done.
+	size_t loadChunkTData(TickableBlock** buffer, int chunk_x, int chunk_z) {
+		size_t size = 0;
+		unsigned char* bytes = readChunkTData(chunk_x, chunk_z, size);
+		size_t item_count = decodeChunkTData(bytes, size, buffer);
+		MemoryPool::release(bytes);
+		return item_count;
+	}
 
-		if (!folder_availabe) return false;
+	// Reads the stored chunk data without decoding it (see decodeChunkData()), nullptr if the chunk was never saved.
+	// The buffer is from MemoryPool, give it back with MemoryPool::release().
+	unsigned char* readChunkData(int chunk_x, int chunk_z, size_t& size) {
+		return read_chunk_file(chunk_x, chunk_z, "", size);
+	}
 
-		int len = strlen(save_folder);
-		char* path = new char[len + 64LL];
-		sprintf(path, "%s%08x%08x.bin", save_folder, chunk_x, chunk_z);
+	// Same as above, for the tickable blocks (see decodeChunkTData()).
+	unsigned char* readChunkTData(int chunk_x, int chunk_z, size_t& size) {
+		return read_chunk_file(chunk_x, chunk_z, "0", size);
+	}
 
-		FILE* fp;
-		fp = fopen(path, "rb");
+	// Decodes chunk data read with readChunkData() ('data' size is not being checked in the method, be aware).
+	// Returns false if 'bytes' is nullptr, 'data' is still filled (with 65535) then.
+	template <typename Shape>
+	static bool decodeChunkData(const unsigned char* bytes, size_t size, unsigned short int* data, Shape shape) {
 
-		if (fp == nullptr) return false;
+		const int area = shape.area();
+		const int chunk_height = shape.height();
 
-		ChunkHeader ch;
-		fread(&ch, sizeof(ChunkHeader), 1, fp);
+		for (int i = 0; i < area * chunk_height; i++) {
+			data[i] = 65535;
+		}
+
+		if (bytes == nullptr) return false;
+
+		size_t pos = sizeof(ChunkHeader);
 		for (int layer = 0; layer < chunk_height; layer++) {
 			LayerHeader lh;
-			fread(&lh, sizeof(LayerHeader), 1, fp);
+			if (!read_bytes(bytes, size, pos, &lh, sizeof(LayerHeader))) break;
 			if (lh.storing == STORE_FLAT) {
 				unsigned short int all;
-				fread(&all, sizeof(unsigned short int), 1, fp);
+				if (!read_bytes(bytes, size, pos, &all, sizeof(unsigned short int))) break;
 				for (int i = 0; i < area; i++) {
 					data[layer * area + i] = all;
 				}
 			}
 			else if (lh.storing == STORE_FULL) {
-				fread(&data[layer * area], sizeof(unsigned short int), area, fp);
+				if (!read_bytes(bytes, size, pos, &data[layer * area], area * sizeof(unsigned short int))) break;
 			}
 
 		}
-		
-		fclose(fp);
+
 		return true;
 	}
 
-	// Loads tickable blocks (Allocates data, call 'delete[] buffer;' after you are done.
-	size_t loadChunkTData(TickableBlock** buffer, int chunk_x, int chunk_z) {
-		if (!folder_availabe) return 0;
-
-		int len = strlen(save_folder);
-		char* path = new char[len + 64LL];
-		sprintf(path, "%s%08x%08x0.bin", save_folder, chunk_x, chunk_z);
-
-		FILE* fp;
-		fp = fopen(path, "rb");
-		delete[] path;
-		path = nullptr;
-
-		if (fp == nullptr) return 0;
+	// Decodes tickable blocks read with readChunkTData() (Allocates data, call 'delete[] buffer;' after you are done.
+	static size_t decodeChunkTData(const unsigned char* bytes, size_t size, TickableBlock** buffer) {
+		if (bytes == nullptr) return 0;
 
+		size_t pos = 0;
 		size_t item_count = 0;
 
-		fread(&item_count, sizeof(size_t), 1, fp);
+		if (!read_bytes(bytes, size, pos, &item_count, sizeof(size_t))) return 0;
+		if (item_count > (size - pos) / sizeof(TickableBlock))
+			item_count = (size - pos) / sizeof(TickableBlock);
 
 		(*buffer) = new TickableBlock[item_count];
 
-		fread(*buffer, sizeof(TickableBlock), item_count, fp);
+		read_bytes(bytes, size, pos, *buffer, item_count * sizeof(TickableBlock));
 
-		fclose(fp);
 		return item_count;
 	}
 
 private:
 
-	const int STORE_FULL = 0;
+	static const int STORE_FULL = 0;
 
-	const int STORE_FLAT = 1;
+	static const int STORE_FLAT = 1;
 
 	void verify_folder() {
 		std::filesystem::path folderPath(save_folder);
@@ -183,6 +211,46 @@ private:
 		}
 	}
 
+	// Reads the whole chunk file ('suffix' follows the coordinates in the name) into a MemoryPool buffer, nullptr if there is no such file.
+	unsigned char* read_chunk_file(int chunk_x, int chunk_z, const char* suffix, size_t& size) {
+		size = 0;
+		if (!folder_availabe) return nullptr;
+
+		int len = strlen(save_folder);
+		char* path = new char[len + 64LL];
+		sprintf(path, "%s%08x%08x%s.bin", save_folder, chunk_x, chunk_z, suffix);
+
+		FILE* fp;
+		fp = fopen(path, "rb");
+		delete[] path;
+		path = nullptr;
+
+		if (fp == nullptr) return nullptr;
+
+		fseek(fp, 0, SEEK_END);
+		long file_size = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		if (file_size < 0) {
+			fclose(fp);
+			return nullptr;
+		}
+
+		unsigned char* bytes = (unsigned char*)MemoryPool::allocate(file_size + 1);
+		size = fread(bytes, 1, file_size, fp);
+
+		fclose(fp);
+		return bytes;
+	}
+
+	// Copies 'count' bytes at 'pos' to 'dst' and moves 'pos' past them, false if there are not enough bytes left.
+	static bool read_bytes(const unsigned char* bytes, size_t size, size_t& pos, void* dst, size_t count) {
+		if (pos > size || count > size - pos)
+			return false;
+		memcpy(dst, bytes + pos, count);
+		pos += count;
+		return true;
+	}
+
 	bool is_data_flat(unsigned short int* start, int len) {
 		unsigned short int beg = start[0];
 		for (int i = 0; i < len; i++) {
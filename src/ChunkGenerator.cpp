@@ -786,8 +786,29 @@ void setNoiseGenerators(FastNoiseLite ngns[16])
 		noisegens[i] = ngns[i];
 }
 
-void putTree(unsigned short int* data, int size, int height, int tree_x, int tree_y, int tree_z, int tree_type, int randd, int day_of_year)
+// Adds a new tickable entry for a block placed by the generator
+void addGeneratedTickable(TickableBlockList* tickable_blocks, unsigned short int block, int x, int y, int z)
 {
+	TickableBlock tb;
+	tb.block_id = block;
+	ChunkTimeStamp cts;
+	cts.year = -1; // means this is a new data
+	tb.x = x;
+	tb.y = y;
+	tb.z = z;
+	tb.last_update = cts;
+	tb.stat1 = tb.stat2 = 0;
+	tb.stat3 = tb.stat4 = 0;
+	tb.stat5 = (float)(rand() % 400) + 800.0f;
+	tickable_blocks->add(tb);
+}
+
+template <typename Shape>
+void putTree(unsigned short int* data, TickableBlockList* tickable_blocks, Shape shape, int tree_x, int tree_y, int tree_z, int tree_type, int randd, int day_of_year)
+{
+	const int size = shape.size();
+	const int height = shape.height();
+
 	auto val = [](int num) { return num < 0 ? -num : num; }; // Compact int abs(int) function
 	auto in = [](int num, int begin, int end) { return num <= end && num >= begin; }; // range checking
 
@@ -886,7 +907,14 @@ void putTree(unsigned short int* data, int size, int height, int tree_x, int tre
 					int chunk_y_index = (ly + tree_y) * size * size;
 					int idx = chunk_x_index + chunk_y_index + chunk_z_index;
 					int block = model[model_x_index + model_z_index + ly * MODEL_WIDTH * MODEL_WIDTH];
-					data[idx] = block == _WOOD ? log_type : block == _LEAF ? leaf_type : data[idx];
+					if (block != _WOOD && block != _LEAF) continue;
+					data[idx] = block == _WOOD ? log_type : leaf_type;
+					// The tree may replace a tickable block (grass, soil)
+					if (!tickable_blocks) continue;
+					if (gamedata::blocks.isTickable(data[idx]))
+						addGeneratedTickable(tickable_blocks, data[idx], lx + tree_x, ly + tree_y, lz + tree_z);
+					else
+						tickable_blocks->remove(lx + tree_x, ly + tree_y, lz + tree_z);
 				}
 			}
 		}
@@ -1011,8 +1039,12 @@ noisegens indices:
 10: Errosion factor
 
 */
-void generateChunk(unsigned short int* data, int size, int height, int base_x, int base_z, ChunkTimeStamp cts)
+template <typename Shape>
+void generateChunk(unsigned short int* data, Shape shape, int base_x, int base_z, ChunkTimeStamp cts, TickableBlockList* tickable_blocks)
 {
+	const int size = shape.size();
+	const int height = shape.height();
+
 	constexpr float min_rain = 0.0f;
 	constexpr float max_rain = 4000.0f;
 	constexpr float min_temp = -25.0f;
@@ -1047,12 +1079,15 @@ void generateChunk(unsigned short int* data, int size, int height, int base_x, i
 
 			for (int y = 0; y < height; y++) {
 				int inda = size * size * y;
-				data[inda + indb + z] = 
+				unsigned short int block =
 					(y <= land_height - soil_layer) ? gamedata::blocks.stone.getID() :
 					(y <= land_height) ? _getSoil(temp, rain, randf1, randf2, land_height - y) :
 					(y >= gamedata::WATER_LEVEL && y == land_height + 1) ? getBushOrGrass(rand_tf, rand_xf, randf1, randf2, temp, rain, cts.day):
 					(y < gamedata::WATER_LEVEL) ? gamedata::blocks.water.getID() :
 					gamedata::blocks.air.getID();
+				data[inda + indb + z] = block;
+				if (tickable_blocks && gamedata::blocks.isTickable(block))
+					addGeneratedTickable(tickable_blocks, block, x, y, z);
 			}
 		}
 	}
@@ -1092,73 +1127,57 @@ void generateChunk(unsigned short int* data, int size, int height, int base_x, i
 				rate *= (rainp / 600.0f);
 				if(ns1 < rate)
 					if(rndi1 % 2 == 0)
-						putTree(data, size, height, x, land_height, z, TREE_SPRUCE, abs(rndi1 + rndi2), cts.day);
+						putTree(data, tickable_blocks, shape, x, land_height, z, TREE_SPRUCE, abs(rndi1 + rndi2), cts.day);
 					else
-						putTree(data, size, height, x, land_height, z, TREE_DWARF_BIRCH, abs(rndi1 + rndi2), cts.day);
+						putTree(data, tickable_blocks, shape, x, land_height, z, TREE_DWARF_BIRCH, abs(rndi1 + rndi2), cts.day);
 			}
 			else if (temp < 5.0f) {
 				if (rndi1 + rndi2 < 47) continue;
 				if (randnum > 0.0f)
-					putTree(data, size, height, x, land_height, z, TREE_SPRUCE, abs(rndi1 + rndi2), cts.day);
+					putTree(data, tickable_blocks, shape, x, land_height, z, TREE_SPRUCE, abs(rndi1 + rndi2), cts.day);
 				else
-					putTree(data, size, height, x, land_height, z, TREE_PINE, abs(rndi1 + rndi2), cts.day);
+					putTree(data, tickable_blocks, shape, x, land_height, z, TREE_PINE, abs(rndi1 + rndi2), cts.day);
 			}
 			else if (temp < 20.0f && rain < 395.0f) {
 				if (rndi1 + rndi2 == 45 && (int)(randnum * 1000.0) % 71 == 0)
-					putTree(data, size, height, x, land_height, z, TREE_MAPLE, abs(rndi1 + rndi2), cts.day);
+					putTree(data, tickable_blocks, shape, x, land_height, z, TREE_MAPLE, abs(rndi1 + rndi2), cts.day);
 				if (rndi1 + rndi2 == 46 && (int)(randnum * 1000.0) % 71 == 0)
-					putTree(data, size, height, x, land_height, z, TREE_MAPLE, abs(rndi1 + rndi2), cts.day);
+					putTree(data, tickable_blocks, shape, x, land_height, z, TREE_MAPLE, abs(rndi1 + rndi2), cts.day);
 			}
 			else if (temp < 20.0f && rain < 795.0f) {
 				if (rndi1 + rndi2 == 45 && (int)(randnum * 100.0) % 11 == 0)
-					putTree(data, size, height, x, land_height, z, TREE_MAPLE, abs(rndi1 + rndi2), cts.day);
+					putTree(data, tickable_blocks, shape, x, land_height, z, TREE_MAPLE, abs(rndi1 + rndi2), cts.day);
 				if (rndi1 + rndi2 == 46 && (int)(randnum * 100.0) % 11 == 0)
-					putTree(data, size, height, x, land_height, z, TREE_MAPLE, abs(rndi1 + rndi2), cts.day);
+					putTree(data, tickable_blocks, shape, x, land_height, z, TREE_MAPLE, abs(rndi1 + rndi2), cts.day);
 			}
 			else if (temp < 20.0f) {
 				if (randnum > 0.5f)
-					putTree(data, size, height, x, land_height, z, TREE_PINE, abs(rndi1 + rndi2), cts.day);
+					putTree(data, tickable_blocks, shape, x, land_height, z, TREE_PINE, abs(rndi1 + rndi2), cts.day);
 				else if (randnum > 0.0f)
-					putTree(data, size, height, x, land_height, z, TREE_BIRCH, abs(rndi1 + rndi2), cts.day);
+					putTree(data, tickable_blocks, shape, x, land_height, z, TREE_BIRCH, abs(rndi1 + rndi2), cts.day);
 				else if (randnum > -0.5f)
-					putTree(data, size, height, x, land_height, z, TREE_MAPLE, abs(rndi1 + rndi2), cts.day);
+					putTree(data, tickable_blocks, shape, x, land_height, z, TREE_MAPLE, abs(rndi1 + rndi2), cts.day);
 			}
 			else if (rain > 500.0f && rain < 2000.0f) {
 				if (rndi1 + rndi2 < 53) continue;
-				putTree(data, size, height, x, land_height, z, TREE_ACACIA, abs(rndi1 + rndi2), cts.day);
+				putTree(data, tickable_blocks, shape, x, land_height, z, TREE_ACACIA, abs(rndi1 + rndi2), cts.day);
 			}
 			else if(rain > 2000.0f) {
-				putTree(data, size, height, x, land_height, z, TREE_JUNGLE, abs(rndi1 + rndi2), cts.day);
+				putTree(data, tickable_blocks, shape, x, land_height, z, TREE_JUNGLE, abs(rndi1 + rndi2), cts.day);
 			}
 			
 		}
 	}
 }
 
-void generateTickableChunkBlocks(std::vector<TickableBlock>* tickable_blocks, unsigned short int* data, int size, int height)
+template void generateChunk(unsigned short int*, ChunkShape<16, 512>, int, int, ChunkTimeStamp, TickableBlockList*);
+template void generateChunk(unsigned short int*, ChunkShape<16, 256>, int, int, ChunkTimeStamp, TickableBlockList*);
+template void generateChunk(unsigned short int*, ChunkShape<32, 32>, int, int, ChunkTimeStamp, TickableBlockList*);
+template void generateChunk(unsigned short int*, ChunkShape<0, 0>, int, int, ChunkTimeStamp, TickableBlockList*);
+
+void generateChunk(unsigned short int* data, int size, int height, int base_x, int base_z, ChunkTimeStamp cts, TickableBlockList* tickable_blocks)
 {
-	for (int x = 0; x < size; x++) {
-		int indb = size * x;
-		for (int z = 0; z < size; z++) {
-			for (int y = 0; y < height; y++) {
-				int inda = size * size * y;
-				if (gamedata::blocks.isTickable(data[inda + indb + z])) {
-					TickableBlock tb;
-					tb.block_id = data[inda + indb + z];
-					ChunkTimeStamp cts;
-					cts.year = -1; // means this is a new data
-					tb.x = x;
-					tb.y = y;
-					tb.z = z;
-					tb.last_update = cts;
-					tb.stat1 = tb.stat2 = 0;
-					tb.stat3 = tb.stat4 = 0;
-					tb.stat5 = (float)(rand() % 400) + 800.0f;
-					tickable_blocks->push_back(tb);
-				}
-			}
-		}
-	}
+	withChunkShape(size, height, [&](auto shape) { generateChunk(data, shape, base_x, base_z, cts, tickable_blocks); });
 }
 
 /*
@@ -3,13 +3,19 @@
 #include "GameData.h"
 #include "FastNoiseLite.h"
 #include "BlockTicks.h"
+#include "ChunkConstants.h"
+#include "TickableBlockList.h"
 #include <vector>
 
 void setNoiseGenerators(FastNoiseLite noisegens[16]);
 
-void generateChunk(unsigned short int* data, int size, int height, int base_x, int base_z, ChunkTimeStamp cts);
+// Tickable blocks are added to 'tickable_blocks' (if not null) as they are placed, so the chunk data does not need another pass.
+// Compiled for ChunkShape<16, 512>, <16, 256>, <32, 32> and <0, 0> (see ChunkConstants.h).
+template <typename Shape>
+void generateChunk(unsigned short int* data, Shape shape, int base_x, int base_z, ChunkTimeStamp cts, TickableBlockList* tickable_blocks = nullptr);
 
-void generateTickableChunkBlocks(std::vector<TickableBlock>* tickable_blocks, unsigned short int* data, int size, int height);
+// Same as above, picks the compiled shape for (size, height).
+void generateChunk(unsigned short int* data, int size, int height, int base_x, int base_z, ChunkTimeStamp cts, TickableBlockList* tickable_blocks = nullptr);
 
 int generateSingleBlock(int x, int y, int z, float& temp, float& rain);
 
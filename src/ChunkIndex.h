@@ -0,0 +1,112 @@
+#pragma once
+
+/*
+Open addressing (linear probing) hash table from chunk coordinates to a slot in the chunk list.
+The table is sized for twice the slot count, so it never gets more than half full.
+Only the owner thread (main thread) should modify it. Entries may point to slots which are freed since, callers must validate the slot.
+*/
+class ChunkIndex
+{
+public:
+
+	ChunkIndex() {
+		capacity = mask = 0;
+		table = nullptr;
+	}
+
+	~ChunkIndex() {
+		destroy();
+	}
+
+	void initialize(int slots) {
+		destroy();
+		capacity = 16;
+		while (capacity < slots * 2)
+			capacity <<= 1;
+		mask = capacity - 1;
+		table = new Entry[capacity];
+		clear();
+	}
+
+	void destroy() {
+		if (table) {
+			delete[] table;
+			table = nullptr;
+		}
+		capacity = mask = 0;
+	}
+
+	void clear() {
+		for (int i = 0; i < capacity; i++)
+			table[i].slot = -1;
+	}
+
+	// Returns the slot stored for (chunk_x, chunk_z), or -1.
+	int find(int chunk_x, int chunk_z) const {
+		int i = hash(chunk_x, chunk_z);
+		while (table[i].slot >= 0) {
+			if (table[i].chunk_x == chunk_x && table[i].chunk_z == chunk_z)
+				return table[i].slot;
+			i = (i + 1) & mask;
+		}
+		return -1;
+	}
+
+	// Stores or replaces the slot for (chunk_x, chunk_z).
+	void insert(int chunk_x, int chunk_z, int slot) {
+		int i = hash(chunk_x, chunk_z);
+		while (table[i].slot >= 0) {
+			if (table[i].chunk_x == chunk_x && table[i].chunk_z == chunk_z)
+				break;
+			i = (i + 1) & mask;
+		}
+		table[i].chunk_x = chunk_x;
+		table[i].chunk_z = chunk_z;
+		table[i].slot = slot;
+	}
+
+	// Removes (chunk_x, chunk_z) if it is stored for 'slot'.
+	void remove(int chunk_x, int chunk_z, int slot) {
+		int i = hash(chunk_x, chunk_z);
+		while (table[i].slot >= 0) {
+			if (table[i].chunk_x == chunk_x && table[i].chunk_z == chunk_z)
+				break;
+			i = (i + 1) & mask;
+		}
+		if (table[i].slot != slot)
+			return;
+
+		// Backward shift, so probe sequences stay unbroken without tombstones
+		int hole = i;
+		int j = (i + 1) & mask;
+		while (table[j].slot >= 0) {
+			int home = hash(table[j].chunk_x, table[j].chunk_z);
+			if (((j - home) & mask) >= ((j - hole) & mask)) {
+				table[hole] = table[j];
+				hole = j;
+			}
+			j = (j + 1) & mask;
+		}
+		table[hole].slot = -1;
+	}
+
+private:
+
+	struct Entry {
+		int chunk_x;
+		int chunk_z;
+		int slot;
+	};
+
+	Entry* table;
+
+	int capacity;
+
+	int mask;
+
+	int hash(int chunk_x, int chunk_z) const {
+		unsigned int h = (unsigned int)chunk_x * 73856093u ^ (unsigned int)chunk_z * 19349663u;
+		h ^= h >> 15;
+		return (int)(h & (unsigned int)mask);
+	}
+};
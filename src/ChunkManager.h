@@ -1,7 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <vector>
 #include "ChunkThread.h"
+#include "ChunkIndex.h"
+#include "SlotLists.h"
 #include "GameData.h"
 #include "BlockTicks.h"
 #include "ChunkGenerator.h"
@@ -15,38 +20,81 @@ struct RenderingChunk {
 	float dst;
 };
 
+// A load or mesh request waiting to be sent to the chunk workers, lower priority values go first.
+struct ChunkRequest {
+	float priority;
+	int slot;
+	bool mesh;
+};
+
+// A chunk which came into load range and waits for a free slot, see ChunkManager::occupyNeededChunks().
+struct NeededChunk {
+	int chunk_x;
+	int chunk_z;
+};
+
 /*
 The class for controlling the memory chunks to be used in a world.
 Firstly, initialize it using initialize(), then you can use updatePlayer() to detect needed chunks around given position and update() to actually load/unload/remesh chunks.
 Remember that update() only updates the chunks that already have been proceed on the chunk thread and does not wait for anything.
+Each slot sits in the list of its state (see SlotLists and settleSlot()), so the per frame work only walks the slots which may have something to do.
 DO NOT DEFINE TWO OR MORE INSTANCES.
 */
 class ChunkManager
 {
 public:
 
-	void initialize(const char* datadir, const char* name, int memory_chunks, int render_dist, const char* seed) {
+	// 'worker_threads' is the number of chunk workers for generating and meshing, 0 uses one less than the hardware threads.
+	// They are split between the build and the mesh stage (at least one each), the file reading and saving has its own CHUNK_IO_WORKERS.
+	void initialize(const char* datadir, const char* name, int memory_chunks, int render_dist, const char* seed, int worker_threads = 0) {
 		int tmp = strlen(name);
 		int tmpp = tmp + 1;
 		world_name = new char[tmpp];
 		memcpy(world_name, name, tmpp);
 		max_memory_chunks = memory_chunks;
 		render_distance = render_dist;
-		free_chunks = max_memory_chunks;
+		load_distance = render_dist + CHUNK_LOAD_MARGIN;
 		active = true;
 
 		chunk_list = new Chunk[max_memory_chunks];
 		render_list = new RenderingChunk[max_memory_chunks];
+		indexed_coords = new int[max_memory_chunks * 2];
+		indexed = new bool[max_memory_chunks];
+		neighbor_slots = new int[max_memory_chunks * 4];
+		pending_requests = new ChunkRequest[max_memory_chunks];
+		left_range_frame = new int[max_memory_chunks];
+		slot_lists.initialize(max_memory_chunks, SLOT_LISTS);
+		chunk_lookup.initialize(max_memory_chunks);
+		needed_chunks.clear();
+		needed_next = 0;
+		residency_valid = false;
+		render_list_dirty = true;
+		MemoryPool::setCapacity(max_memory_chunks * CHUNK_SECTIONS);
+		reserveChunkMemory();
+		last_lookup_slot = -1;
 
 		int seeds[16];
 		hashSeed(seeds, seed);
 
-		chunk_thread::initManagerThread(world_name, datadir, seeds);
-		terrainCalculationThread = new std::thread(chunkManagerThread);
+		if (worker_threads <= 0)
+			worker_threads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+		int stage_workers[CHUNK_STAGES];
+		stage_workers[STAGE_IO] = CHUNK_IO_WORKERS;
+		stage_workers[STAGE_BUILD] = std::max(1, (worker_threads + 1) / 2);
+		stage_workers[STAGE_MESH] = std::max(1, worker_threads - stage_workers[STAGE_BUILD]);
+		chunk_thread::initManagerThread(world_name, datadir, seeds, stage_workers, max_memory_chunks * 3);
+		for (int stage = 0; stage < CHUNK_STAGES; stage++)
+			for (int i = 0; i < stage_workers[stage]; i++)
+				terrain_threads.push_back(new std::thread(chunkManagerThread, stage, i));
+		max_loads_in_flight = stage_workers[STAGE_BUILD] * REQUESTS_IN_FLIGHT_PER_WORKER;
+		max_meshes_in_flight = stage_workers[STAGE_MESH] * REQUESTS_IN_FLIGHT_PER_WORKER;
 
 		for (int i = 0; i < max_memory_chunks; i++) {
 			//chunk_list[i]._activate_no_opengl_debug_mode(); // Only debug
 			chunk_list[i].wipe();
+			indexed[i] = false;
+			for (int n = 0; n < 4; n++)
+				neighbor_slots[i * 4 + n] = -1;
 		}
 
 		while (!chunk_thread::isInitialized())
@@ -56,183 +104,156 @@ public:
 	void destroy() {
 		active = false;
 		saveAndStop();
-		terrainCalculationThread->join();
-		
-		delete terrainCalculationThread;
-		terrainCalculationThread = nullptr;
+		for (size_t i = 0; i < terrain_threads.size(); i++) {
+			terrain_threads[i]->join();
+			delete terrain_threads[i];
+		}
+		terrain_threads.clear();
 
 		delete[] chunk_list;
 		delete[] render_list;
 		delete[] world_name;
+		delete[] indexed_coords;
+		delete[] indexed;
+		delete[] neighbor_slots;
+		delete[] pending_requests;
+		delete[] left_range_frame;
+		slot_lists.destroy();
+		chunk_lookup.destroy();
+		MemoryPool::trim();
 	}
 
 
 	bool chunkExists(int chunk_x, int chunk_z) {
-		for (int i = 0; i < max_memory_chunks; i++) {
-			if (chunk_list[i].getChunkX() == chunk_x && chunk_list[i].getChunkZ() == chunk_z && chunk_list[i].isDataAvailable()) return true;
-		}
-		return false;
+		int slot = findChunkSlot(chunk_x, chunk_z);
+		return slot >= 0 && chunk_list[slot].isDataAvailable();
 	}
 
 	/* 
 	Checks for the needed chunks around player.
-	If there is a chunk in view distance and it is not loaded/loading, occupies a memory space for it.
-	Also when there is no space, it will ignore new chunks.
+	If there is a chunk in view distance (plus CHUNK_LOAD_MARGIN) and it is not loaded/loading, occupies a memory space for it.
+	Also when there is no space, the chunk waits until update() frees some (nearest chunks get the slots first).
+	The needed chunks are only worked out again when the player enters another chunk, from the chunks entering and leaving the range (see moveResidency()).
 	Remember this method is only for checking and assigning memory, see 'void update()'.
 	*/
 	void updatePlayer(int x, int y, int z, float yaw = 0.0f) {
 		int ccx = getChunkNumber(x);
 		int ccz = getChunkNumber(z);
 
-		int chunk_matrix_edge = render_distance * 2 + 1;
-		int matrix_area = chunk_matrix_edge * chunk_matrix_edge;
-		bool* chunk_need_matrix = new bool[matrix_area];
-
-		// Mark all chunks in render distance as needed in relative chunk need matrix.
-		for (int ix = 0; ix < chunk_matrix_edge; ix++) {
-			for (int iz = 0; iz < chunk_matrix_edge; iz++) {
-				chunk_need_matrix[ix * chunk_matrix_edge + iz] = false;
-				int relative_x = ix - render_distance;
-				int relative_z = iz - render_distance;
-				if (quickAbs(relative_x) + quickAbs(relative_z) <= render_distance)
-					chunk_need_matrix[ix * chunk_matrix_edge + iz] = true;
-			}
-		}
+		view_x = cosf(yaw * 3.14159265f / 180.0f);
+		view_z = sinf(yaw * 3.14159265f / 180.0f);
 
-		// Unmark those already exist.
-		int free_ons = 0;
-		for (int i = 0; i < max_memory_chunks; i++) {
-			if (chunk_list[i].isFree()) {
-				free_ons++;
-				continue;
-			}
-			int xc = chunk_list[i].getChunkX() - ccx + render_distance;
-			int zc = chunk_list[i].getChunkZ() - ccz + render_distance;
-
-			if (xc >= 0 && xc < chunk_matrix_edge && zc >= 0 && zc < chunk_matrix_edge) {
-				chunk_need_matrix[xc * chunk_matrix_edge + zc] = false;
-			}
-		}
+		if (!residency_valid || ccx != player_chunk_x || ccz != player_chunk_z)
+			moveResidency(ccx, ccz);
 
-		// Occupy new chunks for any needed chunks (if possible, else just ignore until there's a free space for new chunks)
-		// On each needed chunk (ix, iz), iterrates on main list to find an empty slot, if it reachs the end of list, it will ignore the rest for now.
-		int chunk_index = 0;
-		bool failure = false;
-		for (int ix = 0; ix < chunk_matrix_edge; ix++) {
-			if (failure) break;
-			for (int iz = 0; iz < chunk_matrix_edge; iz++) {
-				if (failure) break;
-				if (chunk_need_matrix[ix * chunk_matrix_edge + iz] == false) continue;
-
-				int cx = ix + ccx - render_distance;
-				int cz = iz + ccz - render_distance;
-
-				while (!chunk_list[chunk_index].isFree()) {
-					chunk_index++;
-					if (chunk_index == max_memory_chunks) {
-						failure = true;
-						break;
-					}
-				}
-				
-				if (failure) break;
-				// Free chunk found on index 'chunk_index', can be occupied
-				free_ons--;
-				chunk_list[chunk_index].wipe();
-				chunk_list[chunk_index].init(cx, cz);
-			}
-		}
-
-		free_chunks = free_ons;
-		delete[] chunk_need_matrix;
+		occupyNeededChunks();
 	}
 
 	/*
 	This method manages the loading, updating and removing the chunks on memory.
-	Loading: The chunks occupied using 'updatePlayer' method which are not yet loaded, will be queued to load.
-	Updating: If the chunk is recently loaded or edited, it will be queued to update the mesh.
-	Deleting: When the occupied terrain memory is almost full, out of view chunks will be queued to delete.
+	Loading: The chunks occupied using 'updatePlayer' method which are not yet loaded, will be queued to load. Those which left the range before loading are freed, queued loads are cancelled first.
+	Updating: If the chunk is recently loaded or edited, it will be queued to update the mesh. Edits made with setBlock() are queued right away (see requestEditRemesh()).
+	A chunk's first mesh is only queued once its four nearby chunks are loaded, those in the load margin are never meshed.
+	Finished meshes are sent to the GPU in updateRenderList(), which runs every frame.
+	Loads and meshes are sent nearest first (see requestPriority()), and only as many as the workers of their stage can start soon, the rest wait for the next call.
+	Deleting: When the occupied terrain memory is almost full, out of view chunks will be queued to delete, those which left the range first.
 	All queues are processed with another thread, and data will be updated
 	*/
 	void update(ChunkTimeStamp now) {
 
-		// Deleting part
-		if (free_chunks < DELETE_CHUNKS_THRESHOLD) {
-			for (int index = 0; index < max_memory_chunks; index++) {
-				if (chunk_list[index].isFree() ||
-					chunk_list[index].isLoadRequested() ||
-					chunk_list[index].isMeshUpdateRequested() ||
-					chunk_list[index].isUnloadRequested() ||
-					chunk_list[index].isOutOfRenderRange() < 10)
+		// Slots the IO workers freed since the last call
+		for (int index = slot_lists.first(SLOTS_UNLOADING), next; index >= 0; index = next) {
+			next = slot_lists.next(index);
+			if (chunk_list[index].isFree())
+				settleSlot(index);
+		}
+
+		// Deleting part, chunks have to be out of range for a few frames
+		if (slot_lists.size(SLOTS_FREE) < DELETE_CHUNKS_THRESHOLD) {
+			for (int index = slot_lists.first(SLOTS_EVICTABLE), next; index >= 0; index = next) {
+				next = slot_lists.next(index);
+				if (render_frames - left_range_frame[index] < 10)
 					continue;
 
+				chunk_list[index].deleteMesh(); // GL objects are only deleted on this thread, the worker frees the rest
 				chunk_thread::enqueueSaveRequest(&chunk_list[index]);
+				settleSlot(index);
 			}
 		}
 
-		// Loading part 
-		for (int index = 0; index < max_memory_chunks; index++) {
-			if (chunk_list[index].isFree() ||
-				chunk_list[index].isDataAvailable() ||
-				chunk_list[index].isLoadRequested() ||
-				chunk_list[index].isUnloadRequested())
-				continue;
-			
-			chunk_list[index].public_chunk_time_stamp = now;
-			chunk_thread::enqueueLoadRequest(&chunk_list[index]);
-		}
+		occupyNeededChunks();
 
-		// Updating part
-		for (int index = 0; index < max_memory_chunks; index++) {
-			if (chunk_list[index].isFree() ||
-				!chunk_list[index].isDataAvailable() ||
-				chunk_list[index].isMeshUpdateRequested() ||
-				chunk_list[index].isUnloadRequested() ||
-				!chunk_list[index].isDataUpdated() ||
-				glfwGetTime() < 1.0)
-				continue;
+		// Loading and updating part, sent from one list by priority. They run on different worker stages, so each has its own limit.
+		int loads_in_flight = 0;
+		int meshes_in_flight = 0;
+		int pending = 0;
+		for (int index = slot_lists.first(SLOTS_LOADING), next; index >= 0; index = next) {
+			next = slot_lists.next(index);
 
-			// If present, update a chunk's nearby chunks
-			Chunk* xp = nullptr;
-			Chunk* xn = nullptr;
-			Chunk* zp = nullptr;
-			Chunk* zn = nullptr;
-			int cx = chunk_list[index].getChunkX();
-			int cz = chunk_list[index].getChunkZ();
-
-			for (int index2 = 0; index2 < max_memory_chunks; index2++) {
-				if (chunk_list[index2].isFree() ||
-					!chunk_list[index2].isDataAvailable() ||
-					chunk_list[index2].isUnloadRequested())
+			if (chunk_list[index].isDataAvailable()) {
+				settleSlot(index); // Built since the last call
+				continue;
+			}
+			if (chunk_list[index].isLoadRequested()) {
+				// Left the range before a worker took the load, nothing to generate
+				if (isInLoadRange(index) || !chunk_thread::cancelLoadRequest(&chunk_list[index])) {
+					loads_in_flight++;
 					continue;
-
-				if (chunk_list[index2].getChunkX() - cx == 1 && chunk_list[index2].getChunkZ() - cz == 0) {
-					xp = &chunk_list[index2];
-				}
-				if (chunk_list[index2].getChunkX() - cx == 0 && chunk_list[index2].getChunkZ() - cz == 1) {
-					zp = &chunk_list[index2];
-				}
-				if (chunk_list[index2].getChunkX() - cx == -1 && chunk_list[index2].getChunkZ() - cz == 0) {
-					xn = &chunk_list[index2];
-				}
-				if (chunk_list[index2].getChunkX() - cx == 0 && chunk_list[index2].getChunkZ() - cz == -1) {
-					zn = &chunk_list[index2];
 				}
 			}
+			if (!isInLoadRange(index)) {
+				chunk_list[index].wipe(); // Not needed anymore, nothing to save
+				settleSlot(index);
+				continue;
+			}
+			pending_requests[pending++] = { requestPriority(index), index, false };
+		}
 
-			chunk_list[index].setAroundChunkPointers(xn, xp, zn, zp);
+		for (int index = slot_lists.first(SLOTS_MESHING), next; index >= 0; index = next) {
+			next = slot_lists.next(index);
 
-			//
-			chunk_thread::enqueueMeshRequest(&chunk_list[index]);
+			if (chunk_list[index].isMeshUpdateRequested()) {
+				if (!chunk_list[index].isNewMeshAvailable())
+					meshes_in_flight++;
+				continue;
+			}
+			if (!chunk_list[index].isDataUpdated() ||
+				!isInRange(index)) {
+				settleSlot(index); // Up to date or out of range, until something marks it again
+				continue;
+			}
+			if (glfwGetTime() < 1.0)
+				continue;
+			// The first mesh waits for the loads of all four nearby chunks, so it is made once. Later ones wait behind the loads.
+			int missing = missingNeighbors(index);
+			if (missing > 0 && !chunk_list[index].isMeshAvailable() && !chunk_list[index].isNewMeshAvailable())
+				continue;
+			pending_requests[pending++] = { requestPriority(index) + missing * (float)render_distance, index, true };
 		}
 
-		// Updating part (send new mesh to GPU)
-		for (int index = 0; index < max_memory_chunks; index++) {
-			if (chunk_list[index].isFree() ||
-				!chunk_list[index].isNewMeshAvailable())
+		std::sort(pending_requests, pending_requests + pending,
+			[](const ChunkRequest& a, const ChunkRequest& b) { return a.priority < b.priority; });
+		for (int i = 0; i < pending; i++) {
+			int index = pending_requests[i].slot;
+
+			if (!pending_requests[i].mesh) {
+				if (loads_in_flight >= max_loads_in_flight)
+					continue;
+				loads_in_flight++;
+				chunk_list[index].public_chunk_time_stamp = now;
+				chunk_thread::enqueueLoadRequest(&chunk_list[index]);
+				continue;
+			}
+
+			if (meshes_in_flight >= max_meshes_in_flight)
 				continue;
+			meshes_in_flight++;
 
-			chunk_list[index].updateVRAM();
+			// If present, update a chunk's nearby chunks
+			chunk_list[index].setAroundChunkPointers(getNeighbor(index, NEIGHBOR_XN), getNeighbor(index, NEIGHBOR_XP), getNeighbor(index, NEIGHBOR_ZN), getNeighbor(index, NEIGHBOR_ZP));
+
+			//
+			chunk_thread::enqueueMeshRequest(&chunk_list[index]);
 		}
 	}
 
@@ -243,9 +264,9 @@ public:
 
 		int cidx = render_list[index].chunk_reference;
 
-		if (cidx < max_memory_chunks && cidx >= 0 && !chunk_list[cidx].isFree() && chunk_list[cidx].isDataAvailable()) {
-			std::vector<TickableBlock>* tickables = chunk_list[cidx].getTickableBlocksPointer();
-			std::vector<TickableBlock>::iterator it;
+		if (cidx < max_memory_chunks && cidx >= 0 && !chunk_list[cidx].isFree() && !chunk_list[cidx].isUnloadRequested() && chunk_list[cidx].isDataAvailable()) {
+			TickableBlockList* tickables = chunk_list[cidx].getTickableBlocksPointer();
+			TickableBlock* it;
 			for (it = tickables->begin(); it != tickables->end(); ++it) {
 
 				if (it->last_update.year == -1) {
@@ -536,6 +557,7 @@ public:
 				}
 				it->last_update = now;
 			}
+			settleSlot(cidx); // A tick may have changed blocks, update() sends the remesh
 		}
 
 		index++;
@@ -553,23 +575,29 @@ public:
 		int z_neighbor = (z - zc * CHUNK_SIZE == 0) ? -1 : (z - zc * CHUNK_SIZE == CHUNK_SIZE - 1) ? 1 : 0;
 
 		bool result = false;
-		int placed_idx = 0;
-		
-		for (int index = 0; index < max_memory_chunks; index++) {
-			if (!chunk_list[index].isFree() && chunk_list[index].isDataAvailable() && chunk_list[index].getChunkX() == xc && chunk_list[index].getChunkZ() == zc) {
-				int lx = x - (xc * CHUNK_SIZE);
-				int lz = z - (zc * CHUNK_SIZE);
-				result = chunk_list[index].setLocalBlock(lx, y, lz, block);
-				chunk_list[index].setUpdateNeededInLayer(y / CHUNK_SIZE);
-				placed_idx = index;
-				if (y % CHUNK_SIZE == 0) chunk_list[index].setUpdateNeededInLayer(y / CHUNK_SIZE - 1); // The out of range will be handled inside setUpdateNeededInLayer
-				if (y % CHUNK_SIZE == CHUNK_SIZE - 1) chunk_list[index].setUpdateNeededInLayer(y / CHUNK_SIZE + 1); // The out of range will be handled inside setUpdateNeededInLayer
-			}
-			if (x_neighbor && !chunk_list[index].isFree() && chunk_list[index].isDataAvailable() && chunk_list[index].getChunkX() == xc + x_neighbor && chunk_list[index].getChunkZ() == zc) {
+		int placed_idx = findChunkSlot(xc, zc);
+
+		if (placed_idx >= 0 && chunk_list[placed_idx].isDataAvailable()) {
+			int lx = x - (xc * CHUNK_SIZE);
+			int lz = z - (zc * CHUNK_SIZE);
+			result = chunk_list[placed_idx].setLocalBlock(lx, y, lz, block);
+			chunk_list[placed_idx].setUpdateNeededInLayer(y / CHUNK_SIZE);
+			if (y % CHUNK_SIZE == 0) chunk_list[placed_idx].setUpdateNeededInLayer(y / CHUNK_SIZE - 1); // The out of range will be handled inside setUpdateNeededInLayer
+			if (y % CHUNK_SIZE == CHUNK_SIZE - 1) chunk_list[placed_idx].setUpdateNeededInLayer(y / CHUNK_SIZE + 1); // The out of range will be handled inside setUpdateNeededInLayer
+			requestEditRemesh(placed_idx);
+		}
+		if (x_neighbor) {
+			int index = findChunkSlot(xc + x_neighbor, zc);
+			if (index >= 0 && chunk_list[index].isDataAvailable()) {
 				chunk_list[index].setUpdateNeededInLayer(y / CHUNK_SIZE);
+				requestEditRemesh(index);
 			}
-			if (z_neighbor && !chunk_list[index].isFree() && chunk_list[index].isDataAvailable() && chunk_list[index].getChunkX() == xc && chunk_list[index].getChunkZ() == zc + z_neighbor) {
+		}
+		if (z_neighbor) {
+			int index = findChunkSlot(xc, zc + z_neighbor);
+			if (index >= 0 && chunk_list[index].isDataAvailable()) {
 				chunk_list[index].setUpdateNeededInLayer(y / CHUNK_SIZE);
+				requestEditRemesh(index);
 			}
 		}
 	
@@ -577,24 +605,15 @@ public:
 			unsigned short int block_read = 0;
 			int local_x = x - (xc * CHUNK_SIZE);
 			int local_z = z - (zc * CHUNK_SIZE);
-			bool exists = false;
-			int idx = 0;
 			chunk_list[placed_idx].getLocalBlock(local_x, y, local_z, block_read);
-			std::vector<TickableBlock>* tblocks = chunk_list[placed_idx].getTickableBlocksPointer();
-			std::vector<TickableBlock>::iterator it;
-			for (it = tblocks->begin(); it != tblocks->end(); ++it) {
-				if (it->x == local_x && it->y == y && it->z == local_z) {
-					exists = true;
-					break;
-				}
-				idx++;
-			}
+			TickableBlockList* tblocks = chunk_list[placed_idx].getTickableBlocksPointer();
+			TickableBlock* existing = tblocks->find(local_x, y, local_z);
 			if (gamedata::blocks.isTickable(block_read)) {
-				if (exists) {
-					tblocks->at(idx).block_id = block_read;
-					tblocks->at(idx).stat1 = tblocks->at(idx).stat2 = 0;
-					tblocks->at(idx).stat3 = tblocks->at(idx).stat4 = tblocks->at(idx).stat5 = 0.0f; // Reseting all values
-					tblocks->at(idx).stat5 = (float)(rand() % 400) + 800.0f;
+				if (existing) {
+					existing->block_id = block_read;
+					existing->stat1 = existing->stat2 = 0;
+					existing->stat3 = existing->stat4 = existing->stat5 = 0.0f; // Reseting all values
+					existing->stat5 = (float)(rand() % 400) + 800.0f;
 					//std::cout << "Tickable block changed at (" << x << "," << y << "," << z << ") to " << gamedata::blocks.indexer[block_read]->getNamePtr() << std::endl;
 				}
 				else
@@ -608,13 +627,13 @@ public:
 					tb.x = local_x;
 					tb.y = y;
 					tb.z = local_z;
-					tblocks->push_back(tb);
+					tblocks->add(tb);
 					//std::cout << "Tickable block create at (" << x << "," << y << "," << z << "). block name: " << gamedata::blocks.indexer[block_read]->getNamePtr() << std::endl;
 				}
 			}
 			else {
-				if (exists) {
-					tblocks->erase(tblocks->begin() + idx);
+				if (existing) {
+					tblocks->remove(local_x, y, local_z);
 					//std::cout << "Tickable block removed" << std::endl;
 				}
 				else {
@@ -633,61 +652,76 @@ public:
 		int xc = getChunkNumber(x);
 		int zc = getChunkNumber(z);
 
-		for (int index = 0; index < max_memory_chunks; index++) {
-			if (!chunk_list[index].isFree() && chunk_list[index].isDataAvailable() && chunk_list[index].getChunkX() == xc && chunk_list[index].getChunkZ() == zc) {
-				int lx = x - (xc * CHUNK_SIZE);
-				int lz = z - (zc * CHUNK_SIZE);
-				return chunk_list[index].getLocalBlock(lx, y, lz, block);
-			}
+		int index = findChunkSlot(xc, zc);
+		if (index >= 0 && chunk_list[index].isDataAvailable()) {
+			int lx = x - (xc * CHUNK_SIZE);
+			int lz = z - (zc * CHUNK_SIZE);
+			return chunk_list[index].getLocalBlock(lx, y, lz, block);
 		}
 
 		return false;
 	}
 
+	// Also sends the finished meshes to the GPU first, so an edit is drawn in the frame right after its remesh is done.
+	// The list is only rebuilt when a mesh was sent or deleted, or the player entered another chunk.
 	void updateRenderList(int x, int y, int z, float yaw = 0.0f) {
 		int px = getChunkNumber(x);
 		int pz = getChunkNumber(z);
-		int iter = 0;
+		render_frames++;
 
-		for (int index = 0; index < max_memory_chunks; index++) {
-			if (!chunk_list[index].isFree() && chunk_list[index].isMeshAvailable()) {
+		for (int index = slot_lists.first(SLOTS_MESHING), next; index >= 0; index = next) {
+			next = slot_lists.next(index);
+			if (!chunk_list[index].isNewMeshAvailable())
+				continue;
+
+			chunk_list[index].updateVRAM();
+			render_list_dirty = true;
+			// Its mesh job may have marked nearby chunks for a remesh, see Chunk::nearbyChunkLoaded()
+			for (int n = 0; n < 4; n++) {
+				int other = neighbor_slots[index * 4 + n];
+				if (other >= 0 && slot_lists.listOf(other) == SLOTS_RESIDENT)
+					settleSlot(other);
+			}
+		}
+
+		if (px != render_list_x || pz != render_list_z)
+			render_list_dirty = true;
+		render_counter = 0;
+		if (!render_list_dirty)
+			return;
+		render_list_dirty = false;
+		render_list_x = px;
+		render_list_z = pz;
+
+		// Chunks in render range are in these two lists (the evictable ones are out of load range)
+		int iter = 0;
+		const int lists[2] = { SLOTS_RESIDENT, SLOTS_MESHING };
+		for (int l = 0; l < 2; l++) {
+			for (int index = slot_lists.first(lists[l]); index >= 0; index = slot_lists.next(index)) {
 				int cx = chunk_list[index].getChunkX();
 				int cz = chunk_list[index].getChunkZ();
-				int dif = quickAbs(px - cx) + quickAbs(pz - cz);
-				if (dif <= render_distance) {
-					int vbo_length;
-					unsigned int vao;
-					chunk_list[index].getRenderInfo(vbo_length, vao);
-					chunk_list[index].setIsInRenderRange(true);
-					render_list[iter].vbo_length = vbo_length;
-					render_list[iter].vao = vao;
-					render_list[iter].cx = cx;
-					render_list[iter].cz = cz;
-					render_list[iter].dst = sqrt((cx - px) * (cx - px) + (cz - pz) * (cz - pz));
-					render_list[iter].chunk_reference = index;
-
-					render_list[iter].finish = false;
-					iter++;
-
-					for (int c = iter - 1; c > 0; c--) {
-						if (render_list[c].dst > render_list[c - 1].dst) {
-							RenderingChunk rc = render_list[c];
-							render_list[c] = render_list[c - 1];
-							render_list[c - 1] = rc;
-						}
-					}
-					
-				}
-				else {
-					chunk_list[index].setIsInRenderRange(false);
-				}
+				if (quickAbs(px - cx) + quickAbs(pz - cz) > render_distance || !chunk_list[index].isMeshAvailable())
+					continue;
+				int vbo_length;
+				unsigned int vao;
+				chunk_list[index].getRenderInfo(vbo_length, vao);
+				render_list[iter].vbo_length = vbo_length;
+				render_list[iter].vao = vao;
+				render_list[iter].cx = cx;
+				render_list[iter].cz = cz;
+				render_list[iter].dst = sqrt((cx - px) * (cx - px) + (cz - pz) * (cz - pz));
+				render_list[iter].chunk_reference = index;
+				render_list[iter].finish = false;
+				iter++;
 			}
 		}
 
+		// Farthest first
+		std::sort(render_list, render_list + iter,
+			[](const RenderingChunk& a, const RenderingChunk& b) { return a.dst > b.dst; });
+
 		if(iter != max_memory_chunks)
 			render_list[iter].finish = true;
-		
-		render_counter = 0;
 	}
 	
 	bool getRenderInfoFor(unsigned int& vao, int& vbo_length, int& cx, int& cz) {
@@ -698,6 +732,31 @@ public:
 		return render_list[render_counter++].finish;
 	}
 
+	// Number of chunks holding block data, and the heap bytes used by their sections.
+	void getMemoryReport(int& loaded_chunks, size_t& data_bytes) {
+		loaded_chunks = 0;
+		data_bytes = 0;
+		for (int index = 0; index < max_memory_chunks; index++) {
+			if (!chunk_list[index].isFree() && !chunk_list[index].isUnloadRequested() && chunk_list[index].isDataAvailable()) {
+				loaded_chunks++;
+				data_bytes += chunk_list[index].getMemoryUsage();
+			}
+		}
+	}
+
+	// Number of chunks with a mesh in VRAM, and their vertices.
+	void getMeshReport(int& meshed_chunks, size_t& vertices) {
+		meshed_chunks = 0;
+		vertices = 0;
+		for (int index = 0; index < max_memory_chunks; index++) {
+			int count = chunk_list[index].getVertexCount();
+			if (count) {
+				meshed_chunks++;
+				vertices += count;
+			}
+		}
+	}
+
 private:
 
 	char* world_name;
@@ -706,17 +765,352 @@ private:
 
 	int render_distance;
 
+	int load_distance; // render_distance + CHUNK_LOAD_MARGIN
+
 	int max_memory_chunks;
 
-	int free_chunks;
-	
 	int render_counter = 0;
 
+	int render_frames = 0; // updateRenderList() calls
+
+	// Player chunk the render list was built for, it is rebuilt when it moves or 'render_list_dirty' is set
+	int render_list_x = 0;
+
+	int render_list_z = 0;
+
+	bool render_list_dirty = true;
+
 	Chunk* chunk_list;
 
 	RenderingChunk* render_list;
 
-	std::thread* terrainCalculationThread;
+	std::vector<std::thread*> terrain_threads;
+
+	// Loads and meshes sent to the workers and not finished yet are kept under these, see update()
+	int max_loads_in_flight;
+
+	int max_meshes_in_flight;
+
+	// Scratch list for sorting the requests in update()
+	ChunkRequest* pending_requests;
+
+	int player_chunk_x = 0;
+
+	int player_chunk_z = 0;
+
+	// False until updatePlayer() set the player's chunk and worked out the needed chunks for it
+	bool residency_valid = false;
+
+	// Chunks in load range without a slot, taken from 'needed_next' on. See occupyNeededChunks().
+	std::vector<NeededChunk> needed_chunks;
+
+	size_t needed_next = 0;
+
+	// One list per slot state, see settleSlot()
+	SlotLists slot_lists;
+
+	static const int SLOTS_FREE = 0;
+	static const int SLOTS_LOADING = 1; // Occupied, the data is not loaded yet (the load may not be sent yet)
+	static const int SLOTS_MESHING = 2; // In render range and marked for a remesh, or its mesh is being made or waits to be sent to the GPU
+	static const int SLOTS_RESIDENT = 3; // Loaded and nothing to do
+	static const int SLOTS_EVICTABLE = 4; // Out of load range, saved and freed once free slots run low
+	static const int SLOTS_UNLOADING = 5; // Being saved and freed by an IO worker
+	static const int SLOT_LISTS = 6;
+
+	// render_frames when the slot became evictable
+	int* left_range_frame;
+
+	// Horizontal view direction from the yaw given to updatePlayer()
+	float view_x = 1.0f;
+
+	float view_z = 0.0f;
+
+	// (chunk x, chunk z) -> slot in chunk_list, see findChunkSlot()
+	ChunkIndex chunk_lookup;
+
+	// Coordinates each slot is indexed with (x, z pairs), valid where 'indexed' is set
+	int* indexed_coords;
+
+	bool* indexed;
+
+	// Slots of the 4 nearby chunks of each slot (NEIGHBOR_* order), -1 if not occupied. Linked and unlinked together with the index.
+	int* neighbor_slots;
+
+	static const int NEIGHBOR_XN = 0;
+	static const int NEIGHBOR_XP = 1;
+	static const int NEIGHBOR_ZN = 2;
+	static const int NEIGHBOR_ZP = 3;
+
+	// Last successful lookup, physics and raycasts hit the same chunk many times in a row
+	int last_lookup_x, last_lookup_z, last_lookup_slot;
+
+	// Returns the slot of the occupied chunk at (chunk_x, chunk_z), or -1. Data may not be available yet.
+	int findChunkSlot(int chunk_x, int chunk_z) {
+		if (last_lookup_slot >= 0 && last_lookup_x == chunk_x && last_lookup_z == chunk_z && isSlotAt(last_lookup_slot, chunk_x, chunk_z))
+			return last_lookup_slot;
+
+		int slot = chunk_lookup.find(chunk_x, chunk_z);
+		if (slot < 0 || !isSlotAt(slot, chunk_x, chunk_z))
+			return -1;
+
+		last_lookup_x = chunk_x;
+		last_lookup_z = chunk_z;
+		last_lookup_slot = slot;
+		return slot;
+	}
+
+	// Chunks being unloaded belong to the IO worker freeing them, they are not found anymore
+	bool isSlotAt(int slot, int chunk_x, int chunk_z) {
+		return !chunk_list[slot].isFree() && !chunk_list[slot].isUnloadRequested() && chunk_list[slot].getChunkX() == chunk_x && chunk_list[slot].getChunkZ() == chunk_z;
+	}
+
+	void indexSlot(int slot, int chunk_x, int chunk_z) {
+		unindexSlot(slot);
+		chunk_lookup.insert(chunk_x, chunk_z, slot);
+		indexed_coords[slot * 2] = chunk_x;
+		indexed_coords[slot * 2 + 1] = chunk_z;
+		indexed[slot] = true;
+
+		linkNeighbor(slot, NEIGHBOR_XN, chunk_lookup.find(chunk_x - 1, chunk_z));
+		linkNeighbor(slot, NEIGHBOR_XP, chunk_lookup.find(chunk_x + 1, chunk_z));
+		linkNeighbor(slot, NEIGHBOR_ZN, chunk_lookup.find(chunk_x, chunk_z - 1));
+		linkNeighbor(slot, NEIGHBOR_ZP, chunk_lookup.find(chunk_x, chunk_z + 1));
+	}
+
+	// Links 'slot' and 'other' both ways, 'direction' is where 'other' lies as seen from 'slot'.
+	void linkNeighbor(int slot, int direction, int other) {
+		neighbor_slots[slot * 4 + direction] = other;
+		if (other >= 0)
+			neighbor_slots[other * 4 + (direction ^ 1)] = slot;
+	}
+
+	// Within render distance of the player's chunk, these are meshed
+	bool isInRange(int slot) {
+		return quickAbs(chunk_list[slot].getChunkX() - player_chunk_x) + quickAbs(chunk_list[slot].getChunkZ() - player_chunk_z) <= render_distance;
+	}
+
+	// Within load distance of the player's chunk, these get a slot
+	bool isInLoadRange(int slot) {
+		return isChunkInLoadRange(chunk_list[slot].getChunkX(), chunk_list[slot].getChunkZ());
+	}
+
+	bool isChunkInLoadRange(int chunk_x, int chunk_z) {
+		return quickAbs(chunk_x - player_chunk_x) + quickAbs(chunk_z - player_chunk_z) <= load_distance;
+	}
+
+	// Moves 'slot' to the list of its state. Called whenever the state may have changed: on the main thread's own requests,
+	// when update() finds a worker finished, and for the chunks entering or leaving the ranges.
+	void settleSlot(int slot) {
+		Chunk& chunk = chunk_list[slot];
+		int list;
+		if (chunk.isFree()) {
+			list = SLOTS_FREE;
+			if (slot_lists.listOf(slot) != SLOTS_FREE && indexed[slot]) {
+				// Unloaded while it came back into range, its save is done now so it can be loaded again
+				if (isChunkInLoadRange(indexed_coords[slot * 2], indexed_coords[slot * 2 + 1]))
+					needed_chunks.push_back({ indexed_coords[slot * 2], indexed_coords[slot * 2 + 1] });
+				unindexSlot(slot);
+			}
+		}
+		else if (chunk.isUnloadRequested())
+			list = SLOTS_UNLOADING;
+		else if (!chunk.isDataAvailable())
+			list = SLOTS_LOADING;
+		else if (chunk.isMeshUpdateRequested() || (chunk.isDataUpdated() && isInRange(slot)))
+			list = SLOTS_MESHING;
+		else if (!isInLoadRange(slot))
+			list = SLOTS_EVICTABLE;
+		else
+			list = SLOTS_RESIDENT;
+
+		if (list == SLOTS_EVICTABLE && slot_lists.listOf(slot) != SLOTS_EVICTABLE)
+			left_range_frame[slot] = render_frames;
+		slot_lists.move(slot, list);
+	}
+
+	// Moves the player to chunk (ccx, ccz). Only the chunks entering or leaving the load and render ranges are looked at (all of the load range the first time),
+	// their slots are settled and those without a slot are added to the needed chunks.
+	void moveResidency(int ccx, int ccz) {
+		int old_x = player_chunk_x;
+		int old_z = player_chunk_z;
+		bool had_range = residency_valid;
+		player_chunk_x = ccx;
+		player_chunk_z = ccz;
+		residency_valid = true;
+
+		auto settle = [this](int chunk_x, int chunk_z) {
+			int slot = findChunkSlot(chunk_x, chunk_z);
+			if (slot >= 0)
+				settleSlot(slot);
+		};
+		auto enter = [this](int chunk_x, int chunk_z) {
+			int slot = findChunkSlot(chunk_x, chunk_z);
+			if (slot >= 0)
+				settleSlot(slot);
+			else
+				needed_chunks.push_back({ chunk_x, chunk_z });
+		};
+		if (had_range) {
+			forEachChunkLeaving(old_x, old_z, ccx, ccz, load_distance, settle);
+			forEachChunkLeaving(old_x, old_z, ccx, ccz, render_distance, settle);
+			forEachChunkLeaving(ccx, ccz, old_x, old_z, render_distance, settle);
+			forEachChunkLeaving(ccx, ccz, old_x, old_z, load_distance, enter);
+		}
+		else {
+			forEachChunkWithin(ccx, ccz, load_distance, enter);
+		}
+
+		// Nearest first, those which left the range are dropped
+		size_t kept = 0;
+		for (size_t i = needed_next; i < needed_chunks.size(); i++)
+			if (isChunkInLoadRange(needed_chunks[i].chunk_x, needed_chunks[i].chunk_z))
+				needed_chunks[kept++] = needed_chunks[i];
+		needed_chunks.resize(kept);
+		needed_next = 0;
+		std::sort(needed_chunks.begin(), needed_chunks.end(), [ccx, ccz](const NeededChunk& a, const NeededChunk& b) {
+			return (a.chunk_x - ccx) * (a.chunk_x - ccx) + (a.chunk_z - ccz) * (a.chunk_z - ccz) < (b.chunk_x - ccx) * (b.chunk_x - ccx) + (b.chunk_z - ccz) * (b.chunk_z - ccz);
+		});
+	}
+
+	// Gives free slots to the needed chunks in order, until the free slots run out. The rest wait for the slots update() frees.
+	void occupyNeededChunks() {
+		while (needed_next < needed_chunks.size() && slot_lists.size(SLOTS_FREE) > 0) {
+			NeededChunk needed = needed_chunks[needed_next++];
+			if (!isChunkInLoadRange(needed.chunk_x, needed.chunk_z) || isChunkHeld(needed.chunk_x, needed.chunk_z))
+				continue;
+			int slot = slot_lists.first(SLOTS_FREE);
+			chunk_list[slot].wipe();
+			chunk_list[slot].init(needed.chunk_x, needed.chunk_z);
+			indexSlot(slot, needed.chunk_x, needed.chunk_z);
+			settleSlot(slot);
+		}
+		if (needed_next == needed_chunks.size()) {
+			needed_chunks.clear();
+			needed_next = 0;
+		}
+	}
+
+	// True if a slot holds the chunk, also while it is being unloaded: it must not be loaded before its save is done, settleSlot() adds it again once the slot is freed.
+	bool isChunkHeld(int chunk_x, int chunk_z) {
+		int slot = chunk_lookup.find(chunk_x, chunk_z);
+		return slot >= 0 && !chunk_list[slot].isFree() && chunk_list[slot].getChunkX() == chunk_x && chunk_list[slot].getChunkZ() == chunk_z;
+	}
+
+	// Calls visit(chunk_x, chunk_z) for each chunk within 'radius' of (center_x, center_z), same shape as isInLoadRange().
+	template <typename Visit> void forEachChunkWithin(int center_x, int center_z, int radius, Visit visit) {
+		for (int dx = -radius; dx <= radius; dx++) {
+			int half = radius - quickAbs(dx);
+			for (int z = center_z - half; z <= center_z + half; z++)
+				visit(center_x + dx, z);
+		}
+	}
+
+	// Calls visit(chunk_x, chunk_z) for each chunk within 'radius' of (from_x, from_z) which is not within 'radius' of (to_x, to_z).
+	// Goes row by row, a row of one range minus the other is at most two runs, so a one chunk step only costs a ring.
+	template <typename Visit> void forEachChunkLeaving(int from_x, int from_z, int to_x, int to_z, int radius, Visit visit) {
+		for (int dx = -radius; dx <= radius; dx++) {
+			int x = from_x + dx;
+			int half = radius - quickAbs(dx);
+			int to_half = radius - quickAbs(x - to_x);
+			int low = from_z - half;
+			int high = from_z + half;
+			if (to_half < 0) {
+				for (int z = low; z <= high; z++)
+					visit(x, z);
+				continue;
+			}
+			for (int z = low; z <= std::min(high, to_z - to_half - 1); z++)
+				visit(x, z);
+			for (int z = std::max(low, to_z + to_half + 1); z <= high; z++)
+				visit(x, z);
+		}
+	}
+
+	// Distance from the player's chunk, up to doubled for chunks behind the view direction
+	float requestPriority(int slot) {
+		float dx = (float)(chunk_list[slot].getChunkX() - player_chunk_x);
+		float dz = (float)(chunk_list[slot].getChunkZ() - player_chunk_z);
+		float distance = sqrtf(dx * dx + dz * dz);
+		if (distance == 0.0f)
+			return 0.0f;
+		float facing = (dx * view_x + dz * view_z) / distance;
+		return distance * (1.5f - 0.5f * facing);
+	}
+
+	// Nearby chunks in load range whose data is not loaded yet
+	int missingNeighbors(int slot) {
+		static const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } }; // NEIGHBOR_* order
+		int missing = 0;
+		for (int n = 0; n < 4; n++) {
+			Chunk* neighbor = getNeighbor(slot, n);
+			if (neighbor && neighbor->isDataAvailable())
+				continue;
+			int cx = chunk_list[slot].getChunkX() + offsets[n][0];
+			int cz = chunk_list[slot].getChunkZ() + offsets[n][1];
+			if (quickAbs(cx - player_chunk_x) + quickAbs(cz - player_chunk_z) <= load_distance)
+				missing++;
+		}
+		return missing;
+	}
+
+	// Remeshes an edited chunk right away on the urgent lane, without waiting for update(). A queued mesh of the chunk takes the edit and moves to the urgent lane.
+	// If its mesh is already being made, update() picks the edit up later.
+	void requestEditRemesh(int slot) {
+		if (chunk_list[slot].isUnloadRequested())
+			return;
+		if (!chunk_list[slot].isMeshUpdateRequested())
+			chunk_list[slot].setAroundChunkPointers(getNeighbor(slot, NEIGHBOR_XN), getNeighbor(slot, NEIGHBOR_XP), getNeighbor(slot, NEIGHBOR_ZN), getNeighbor(slot, NEIGHBOR_ZP));
+		chunk_thread::enqueueMeshRequest(&chunk_list[slot], true);
+		settleSlot(slot);
+	}
+
+	// The nearby chunk in 'direction' if it can be used for meshing, else nullptr. The mesh job checks if its data is loaded by then.
+	Chunk* getNeighbor(int slot, int direction) {
+		int other = neighbor_slots[slot * 4 + direction];
+		if (other < 0 ||
+			chunk_list[other].isFree() ||
+			chunk_list[other].isUnloadRequested())
+			return nullptr;
+		return &chunk_list[other];
+	}
+
+	void unindexSlot(int slot) {
+		if (!indexed[slot])
+			return;
+		chunk_lookup.remove(indexed_coords[slot * 2], indexed_coords[slot * 2 + 1], slot);
+		indexed[slot] = false;
+		for (int n = 0; n < 4; n++) {
+			int other = neighbor_slots[slot * 4 + n];
+			if (other >= 0)
+				neighbor_slots[other * 4 + (n ^ 1)] = -1;
+			neighbor_slots[slot * 4 + n] = -1;
+		}
+		if (last_lookup_slot == slot)
+			last_lookup_slot = -1;
+	}
+
+	// Fills MemoryPool with what max_memory_chunks loaded chunks usually hold, so streaming does not reach the heap once the first area is loaded.
+	// Per chunk (measured while streaming): the two mesh piece arrays, about 1.5 section objects, 1.5 storages of 2 and 4 bits and less of the others, up to 0.3 mesh pieces of each size from 4 KB up.
+	// The small sizes left are save file buffers.
+	void reserveChunkMemory() {
+		int chunks = max_memory_chunks;
+		for (size_t bytes = 16; bytes < 4096; bytes *= 2) {
+			MemoryPool::reserve(bytes, chunks / 8);
+			MemoryPool::reserve(bytes + bytes / 2, chunks / 8);
+		}
+		MemoryPool::reserve(sizeof(ChunkVertex*) * CHUNK_SECTIONS, chunks);
+		MemoryPool::reserve(sizeof(int) * CHUNK_SECTIONS, chunks);
+		MemoryPool::reserve(sizeof(ChunkSection), chunks * 2);
+		MemoryPool::reserve(ChunkSection::packedBytes(1), chunks / 2);
+		MemoryPool::reserve(ChunkSection::packedBytes(2), chunks * 3 / 2);
+		MemoryPool::reserve(ChunkSection::packedBytes(4), chunks * 3 / 2);
+		MemoryPool::reserve(ChunkSection::packedBytes(8), chunks / 4);
+		MemoryPool::reserve(ChunkSection::packedBytes(16), chunks / 4);
+		for (size_t bytes = 4096; bytes <= 32768; bytes *= 2) {
+			MemoryPool::reserve(bytes, chunks / 3);
+			MemoryPool::reserve(bytes + bytes / 2, chunks / 3);
+		}
+	}
 
 	int getChunkNumber(int v) {
 		return (v < 0) ? ((v + 1) / 16 - 1) : (v / 16);
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "ChunkConstants.h"
+#include "EpochReclaimer.h"
+#include "MemoryPool.h"
+
+/*
+A CHUNK_SIZE^3 piece of chunk data, stored as a block palette plus bit-packed palette indices.
+Blocks are indexed the same way as a flat chunk layer array: (y * CHUNK_AREA) + (x * CHUNK_SIZE) + z, with y local to the section.
+When a write needs a new palette entry, the index width grows (0, 1, 2, 4, 8 bits). With more than 256 different blocks, block ids are stored directly (16 bits).
+Palette and indices live in one buffer behind a single pointer. The chunk workers may read a section while the main thread writes to it, so replaced buffers are retired
+to the workers' EpochReclaimer (see setReclaimer()) instead of deleted.
+Sections made of a single block id are shared: ChunkSection::fromData() returns one read-only instance per id (see getShared()).
+Shared sections must never be written or deleted, the owner replaces them with its own copy on the first write.
+Mesh jobs hold the sections they read (see acquire()). The writer only writes in place when nobody holds the section (see beginWrite()),
+else it writes a clone() and retires the old section, so a held section never changes.
+*/
+class ChunkSection
+{
+public:
+
+	ChunkSection(unsigned short int block = 0) {
+		Storage* s = createStorage(0);
+		s->palette()[0] = block;
+		s->palette_size = 1;
+		storage.store(s, std::memory_order_relaxed);
+	}
+
+	~ChunkSection() {
+		deleteStorage(storage.load(std::memory_order_relaxed));
+	}
+
+	// A private copy of the section, for copy on write.
+	ChunkSection* clone() const {
+		const Storage* s = storage.load(std::memory_order_acquire);
+		Storage* copy = createStorage(s->bits);
+		memcpy(copy, s, storageSize(s->bits));
+		return new ChunkSection(copy);
+	}
+
+	ChunkSection(const ChunkSection&) = delete;
+
+	ChunkSection& operator=(const ChunkSection&) = delete;
+
+	static void* operator new(size_t size) {
+		return MemoryPool::allocate(size);
+	}
+
+	static void operator delete(void* ptr) {
+		MemoryPool::release(ptr);
+	}
+
+	// Returns the shared section for 'src' (CHUNK_SECTION_VOLUME blocks) if it is uniform, else a new packed section.
+	static ChunkSection* fromData(const unsigned short int* src) {
+		int i = 1;
+		while (i < CHUNK_SECTION_VOLUME && src[i] == src[0])
+			i++;
+		if (i == CHUNK_SECTION_VOLUME)
+			return getShared(src[0]);
+		ChunkSection* section = new ChunkSection();
+		section->pack(src);
+		return section;
+	}
+
+	// The read-only section filled with 'block', created on first use and kept until the program ends.
+	static ChunkSection* getShared(unsigned short int block) {
+		std::lock_guard<std::mutex> lock(shared_mutex);
+		ChunkSection*& section = shared_sections[block];
+		if (!section) {
+			section = new ChunkSection(block);
+			section->shared = true;
+		}
+		return section;
+	}
+
+	unsigned short int getBlock(int index) const {
+		return blockAt(storage.load(std::memory_order_acquire), index);
+	}
+
+	void setBlock(int index, unsigned short int block) {
+		int value = findPaletteIndex(storage.load(std::memory_order_relaxed), block);
+		if (value < 0)
+			value = addToPalette(block);
+		writeIndex(storage.load(std::memory_order_relaxed), index, value);
+	}
+
+	// Replaces the whole section with 'src' (CHUNK_SECTION_VOLUME blocks). Only for sections nobody else is reading yet.
+	void pack(const unsigned short int* src) {
+		unsigned short int palette[256];
+		int palette_size = 0;
+		int last = -1;
+		for (int i = 0; i < CHUNK_SECTION_VOLUME && palette_size <= 256; i++) {
+			if (last >= 0 && palette[last] == src[i])
+				continue;
+			last = -1;
+			for (int p = 0; p < palette_size; p++) {
+				if (palette[p] == src[i]) {
+					last = p;
+					break;
+				}
+			}
+			if (last < 0) {
+				if (palette_size == 256) {
+					palette_size++;
+					break;
+				}
+				palette[palette_size] = src[i];
+				last = palette_size++;
+			}
+		}
+
+		Storage* s = createStorage(bitsForPaletteSize(palette_size));
+		if (s->bits != 16) {
+			memcpy(s->palette(), palette, palette_size * sizeof(unsigned short int));
+			s->palette_size = palette_size;
+		}
+		if (s->bits != 0) {
+			for (int i = 0; i < CHUNK_SECTION_VOLUME; i++)
+				writeIndex(s, i, findPaletteIndex(s, src[i]));
+		}
+
+		deleteStorage(storage.exchange(s, std::memory_order_release));
+	}
+
+	// Writes all CHUNK_SECTION_VOLUME blocks of the section to 'dst'. Each row of CHUNK_SIZE blocks (along z) goes 'row_stride' after the one before it
+	// and each layer 'layer_stride' after the one below it, so it can also fill the inside of a larger (padded) buffer.
+	void unpack(unsigned short int* dst, int row_stride = CHUNK_SIZE, int layer_stride = CHUNK_AREA) const {
+		const Storage* s = storage.load(std::memory_order_acquire);
+		for (int y = 0; y < CHUNK_SIZE; y++) {
+			for (int x = 0; x < CHUNK_SIZE; x++) {
+				unsigned short int* row = &dst[y * layer_stride + x * row_stride];
+				int index = y * CHUNK_AREA + x * CHUNK_SIZE;
+				if (s->bits == 0) {
+					for (int z = 0; z < CHUNK_SIZE; z++)
+						row[z] = s->palette()[0];
+				}
+				else {
+					for (int z = 0; z < CHUNK_SIZE; z++)
+						row[z] = blockAt(s, index + z);
+				}
+			}
+		}
+	}
+
+	bool isUniform() const {
+		return storage.load(std::memory_order_acquire)->bits == 0;
+	}
+
+	bool isShared() const {
+		return shared;
+	}
+
+	// Only valid for uniform sections.
+	unsigned short int getUniformBlock() const {
+		return storage.load(std::memory_order_acquire)->palette()[0];
+	}
+
+	int getBitsPerBlock() const {
+		return storage.load(std::memory_order_acquire)->bits;
+	}
+
+	// Bytes used by the section on heap (object + palette + indices), shared sections are not counted.
+	size_t getMemoryUsage() const {
+		if (shared)
+			return 0;
+		return sizeof(ChunkSection) + storageSize(storage.load(std::memory_order_acquire)->bits);
+	}
+
+	// Reader side. While held, the section is never written (writers copy it instead). Not needed for shared sections, they never change.
+	void acquire() {
+		holders.fetch_add(1);
+	}
+
+	void release() {
+		holders.fetch_sub(1);
+	}
+
+	// Reader side, right after acquire(): waits for a write in place which started before it.
+	void waitForWriter() const {
+		while (writing.load())
+			std::this_thread::yield();
+	}
+
+	// Writer side. True if the section may be written in place now (call endWrite() after), false if it is held and must be copied.
+	// Both sides announce themselves before looking at the other, so either the writer sees the holder or the holder waits for the write.
+	bool beginWrite() {
+		writing.store(true);
+		if (holders.load() == 0)
+			return true;
+		writing.store(false);
+		return false;
+	}
+
+	void endWrite() {
+		writing.store(false);
+	}
+
+	// Storages replaced by palette growth and sections replaced by copies are retired to 'epochs' while other threads may read sections, nullptr deletes them right away.
+	static void setReclaimer(EpochReclaimer* epochs) {
+		reclaimer = epochs;
+	}
+
+	// Deletes 'section' once no reader can see it anymore. The caller already replaced it.
+	static void retire(ChunkSection* section) {
+		if (reclaimer)
+			reclaimer->retire(section, deleteRetired);
+		else
+			delete section;
+	}
+
+	// Bytes of the block storage of a section packed with 'bits' bits per block, for sizing MemoryPool (see ChunkManager::initialize())
+	static size_t packedBytes(int bits) {
+		return storageSize(bits);
+	}
+
+private:
+
+	struct Storage {
+		int bits;
+		int palette_size;
+		int palette_capacity;
+		int word_count;
+
+		unsigned int* indices() {
+			return (unsigned int*)(this + 1);
+		}
+
+		const unsigned int* indices() const {
+			return (const unsigned int*)(this + 1);
+		}
+
+		unsigned short int* palette() {
+			return (unsigned short int*)(indices() + word_count);
+		}
+
+		const unsigned short int* palette() const {
+			return (const unsigned short int*)(indices() + word_count);
+		}
+	};
+
+	std::atomic<Storage*> storage; // Replaced by the writer (the main thread), read by any thread
+
+	bool shared = false;
+
+	std::atomic<int> holders{ 0 }; // Readers holding the section, see acquire()
+
+	std::atomic<bool> writing{ false }; // A write in place is running, see beginWrite()
+
+	static inline std::mutex shared_mutex;
+
+	static inline std::unordered_map<unsigned short int, ChunkSection*> shared_sections;
+
+	static inline EpochReclaimer* reclaimer = nullptr;
+
+	ChunkSection(Storage* s) {
+		storage.store(s, std::memory_order_relaxed);
+	}
+
+	static unsigned short int blockAt(const Storage* s, int index) {
+		if (s->bits == 0)
+			return s->palette()[0];
+		unsigned int bit = index * s->bits;
+		unsigned int value = (s->indices()[bit >> 5] >> (bit & 31)) & ((1u << s->bits) - 1);
+		if (s->bits == 16)
+			return value;
+		return s->palette()[value];
+	}
+
+	static void deleteRetired(void* section) {
+		delete (ChunkSection*)section;
+	}
+
+	static int bitsForPaletteSize(int palette_size) {
+		if (palette_size <= 1) return 0;
+		if (palette_size <= 2) return 1;
+		if (palette_size <= 4) return 2;
+		if (palette_size <= 16) return 4;
+		if (palette_size <= 256) return 8;
+		return 16;
+	}
+
+	static int paletteCapacity(int bits) {
+		return (bits == 16) ? 0 : (1 << bits);
+	}
+
+	static int wordCount(int bits) {
+		return CHUNK_SECTION_VOLUME * bits / 32;
+	}
+
+	static size_t storageSize(int bits) {
+		return sizeof(Storage) + wordCount(bits) * sizeof(unsigned int) + paletteCapacity(bits) * sizeof(unsigned short int);
+	}
+
+	static Storage* createStorage(int bits) {
+		Storage* s = (Storage*)MemoryPool::allocate(storageSize(bits));
+		s->bits = bits;
+		s->palette_size = 0;
+		s->palette_capacity = paletteCapacity(bits);
+		s->word_count = wordCount(bits);
+		memset(s->indices(), 0, s->word_count * sizeof(unsigned int));
+		return s;
+	}
+
+	static void deleteStorage(Storage* s) {
+		MemoryPool::release(s);
+	}
+
+	static int findPaletteIndex(const Storage* s, unsigned short int block) {
+		if (s->bits == 16)
+			return block;
+		const unsigned short int* palette = s->palette();
+		for (int i = 0; i < s->palette_size; i++)
+			if (palette[i] == block)
+				return i;
+		return -1;
+	}
+
+	static void writeIndex(Storage* s, int index, int value) {
+		if (s->bits == 0)
+			return;
+		unsigned int bit = index * s->bits;
+		unsigned int mask = ((1u << s->bits) - 1) << (bit & 31);
+		unsigned int& word = s->indices()[bit >> 5];
+		word = (word & ~mask) | (((unsigned int)value << (bit & 31)) & mask);
+	}
+
+	// Adds 'block' to the palette and returns its index, re-encoding the section with wider indices when the palette is full.
+	int addToPalette(unsigned short int block) {
+		Storage* s = storage.load(std::memory_order_relaxed);
+		if (s->palette_size < s->palette_capacity) {
+			s->palette()[s->palette_size] = block;
+			return s->palette_size++;
+		}
+
+		Storage* grown = createStorage(bitsForPaletteSize(s->palette_size + 1));
+		if (grown->bits == 16) {
+			for (int i = 0; i < CHUNK_SECTION_VOLUME; i++)
+				writeIndex(grown, i, getBlock(i));
+		}
+		else {
+			memcpy(grown->palette(), s->palette(), s->palette_size * sizeof(unsigned short int));
+			grown->palette_size = s->palette_size;
+			if (s->bits != 0) {
+				for (int i = 0; i < CHUNK_SECTION_VOLUME; i++) {
+					unsigned int bit = i * s->bits;
+					writeIndex(grown, i, (s->indices()[bit >> 5] >> (bit & 31)) & ((1u << s->bits) - 1));
+				}
+			}
+			grown->palette()[grown->palette_size] = block;
+			grown->palette_size++;
+		}
+
+		storage.store(grown, std::memory_order_release);
+		if (reclaimer)
+			reclaimer->retire(s, MemoryPool::release);
+		else
+			deleteStorage(s);
+		return findPaletteIndex(grown, block);
+	}
+
+};
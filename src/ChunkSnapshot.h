@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ChunkConstants.h"
+#include "ChunkSection.h"
+
+/*
+The block data of a chunk as it was when a mesh job took it, see Chunk::takeSnapshot().
+The held sections never change (the main thread writes copies of them meanwhile), so reading them never sees a half made edit.
+Release it with Chunk::releaseSnapshot() before the job ends, the sections replaced meanwhile are freed after the job.
+*/
+class ChunkSnapshot
+{
+public:
+
+	bool getLocalBlock(int x, int y, int z, unsigned short int& block) const {
+		if (x < 0 || x >= CHUNK_SIZE || y < 0 || y >= CHUNK_HEIGHT || z < 0 || z >= CHUNK_SIZE)
+			return false;
+		block = sections[y / CHUNK_SIZE]->getBlock((y % CHUNK_SIZE) * CHUNK_AREA + x * CHUNK_SIZE + z);
+		return true;
+	}
+
+	// Same as Chunk::getColumnHeight() and Chunk::getColumnLightHeight()
+	int getColumnHeight(int x, int z) const {
+		return height_map[x * CHUNK_SIZE + z];
+	}
+
+	int getColumnLightHeight(int x, int z) const {
+		return light_map[x * CHUNK_SIZE + z];
+	}
+
+	// Block 'index' (y * CHUNK_AREA + x * CHUNK_SIZE + z) of vertical section 'section', no bounds checks.
+	unsigned short int getSectionBlock(int section, int index) const {
+		return sections[section]->getBlock(index);
+	}
+
+	// See ChunkSection::unpack()
+	void unpackSection(int section, unsigned short int* dst, int row_stride = CHUNK_SIZE, int layer_stride = CHUNK_AREA) const {
+		sections[section]->unpack(dst, row_stride, layer_stride);
+	}
+
+	bool isSectionUniform(int section, unsigned short int& block) const {
+		if (section < 0 || section >= CHUNK_SECTIONS || !sections[section]->isUniform())
+			return false;
+		block = sections[section]->getUniformBlock();
+		return true;
+	}
+
+private:
+
+	friend class Chunk;
+
+	ChunkSection* sections[CHUNK_SECTIONS];
+
+	unsigned int versions[CHUNK_SECTIONS]; // Chunk's section versions when taken, see Chunk::getSectionsChangedSince()
+
+	short int height_map[CHUNK_AREA];
+
+	short int light_map[CHUNK_AREA];
+
+};
@@ -1,19 +1,94 @@
 #include <vector>
 #include <cmath>
 #include <cstring>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "ChunkDataFile.h"
 #include "ChunkThread.h"
 #include "ChunkGenerator.h"
+#include "EpochReclaimer.h"
+#include "Queue.h"
 
-Queue<Chunk*>* load_queue;
-Queue<Chunk*>* save_queue;
-Queue<Chunk*>* mesh_queue;
+enum ChunkJobType { JOB_LOAD, JOB_BUILD, JOB_MESH, JOB_SAVE };
 
-bool active = false;
+struct ChunkJob {
+	ChunkJobType type;
+	Chunk* chunk;
+	unsigned int ticket; // Load and mesh jobs only run if they can redeem it, see JobTicket
+	long long queued_at; // Microseconds, for the stage histograms
+	int chunk_x; // Load and build jobs: the chunk position when it was requested. The IO stage only uses these, the chunk may be cancelled and reused meanwhile.
+	int chunk_z;
+	unsigned char* file; // Build jobs: the chunk files read by the IO stage, nullptr if the chunk was never saved
+	size_t file_size;
+	unsigned char* tfile;
+	size_t tfile_size;
+};
 
-void loadOrGenerate(Chunk* chunk);
+// Jobs taken at once from a worker's own queue
+#define JOB_BATCH 4
 
-void remeshChunk(Chunk* chunk);
+// Times a mesh job remeshes the sections edited while it ran before it publishes a stale mesh (the edits queued another remesh anyway)
+#define MESH_STALE_RETRIES 2
+
+// The queues and the workers of one stage, see ChunkStage
+struct StageQueues {
+	Queue<ChunkJob>* queues = nullptr; // One per worker of the stage. The owner takes batches of jobs, idle workers steal single jobs from the others.
+
+	int workers = 0;
+
+	int first_reader = 0; // Reader slot of the stage's first worker in section_epochs
+
+	std::atomic<int> next_queue{ 0 }; // Round robin target for new jobs
+
+	Queue<ChunkJob> urgent; // Taken before the workers' own queues, used for remeshing the player's edits and for loads (saves can wait, a burst of them must not hold loads back)
+
+	std::mutex wake_mutex; // Idle workers wait on 'wake_signal' until pushJob() adds a job or saveAndKill() stops them
+
+	std::condition_variable wake_signal;
+
+	int sleeping_workers = 0; // Guarded by wake_mutex
+
+	LatencyHistogram wait_time; // From being queued to being started
+
+	LatencyHistogram run_time;
+};
+
+StageQueues stages[CHUNK_STAGES];
+
+std::atomic<unsigned long long> dropped_jobs{ 0 };
+
+std::atomic<unsigned long long> merged_requests{ 0 };
+
+std::atomic<unsigned long long> stale_meshes{ 0 };
+
+std::atomic<unsigned long long> meshed_sections{ 0 };
+
+thread_local ChunkJob job_batch[JOB_BATCH];
+thread_local int job_batch_count = 0;
+thread_local int job_batch_next = 0;
+
+int total_workers = 0;
+
+std::atomic<int> ready_workers{ 0 };
+
+std::atomic<int> running_workers{ 0 };
+
+std::atomic<bool> active{ false };
+
+EpochReclaimer section_epochs; // Every job runs as a reader, section storages replaced by block writes are freed once the jobs which could see them are done
+
+void readChunkFiles(ChunkJob job);
+
+void buildChunk(const ChunkJob& job);
+
+void remeshChunk(Chunk* chunk, unsigned int sections, const ChunkSnapshot* snapshot, const ChunkSnapshot* const nearby[4]);
+
+void meshChunkJob(Chunk* chunk);
 
 void saveAndFreeChunk(Chunk* chunk);
 
@@ -21,60 +96,263 @@ FastNoiseLite noisegen[16];
 
 char* path;
 
-int chunkManagerThread()
+thread_local unsigned short int* chunk_data_buffer = nullptr; // Flat chunk data used while generating, loading or saving
+
+thread_local ChunkVertex* mesh_buffer = nullptr; // Scratch buffers for meshing a vertical section, see remeshChunk()
+thread_local ChunkVertex* mesh_liquid_buffer = nullptr;
+
+// Block faces of a vertical section waiting to be written, MESH_FACES masks of CHUNK_SECTION_VOLUME, 0 or block and light (see markFace()). All zero between sections
+thread_local unsigned int* face_masks = nullptr;
+
+enum MeshFace { FACE_BOTTOM, FACE_TOP, FACE_XN, FACE_XP, FACE_ZN, FACE_ZP, MESH_FACES };
+
+// The vertical section being meshed with a one block border from the sections above and below and the nearby chunks, see gatherSection()
+#define PAD_SIZE (CHUNK_SIZE + 2)
+#define PAD_AREA (PAD_SIZE * PAD_SIZE)
+thread_local unsigned short int* padded_blocks = nullptr;
+
+// Visible faces of a section as bit rows, bit z of row y * CHUNK_SIZE + x, see cullFaces()
+static_assert(CHUNK_SIZE <= 16 && PAD_SIZE <= 32, "Section rows must fit the face row bits");
+typedef unsigned short int FaceRow;
+
+// What the face culling needs to know about a block, one bit each (see cullFaces()). Filled by initManagerThread() from gamedata::blocks
+// One per possible id, the ids of blocks which do not exist (damaged chunk files) read air's entries in BlockData, so they are only CLASS_TRANSPARENT
+enum BlockClass { CLASS_TRANSPARENT, CLASS_RENDERABLE, CLASS_SOLID, CLASS_LIQUID, CLASS_MODEL, BLOCK_CLASSES };
+#define BLOCK_ID_RANGE (1 << 16)
+unsigned char block_classes[BLOCK_ID_RANGE];
+
+std::atomic<bool> greedy_meshing{ CHUNK_GREEDY_MESHING };
+std::atomic<bool> bit_plane_culling{ true };
+std::atomic<bool> edge_only_invalidation{ true };
+
+long long nowMicroseconds()
 {
-	load_queue = new Queue<Chunk*>;
-	save_queue = new Queue<Chunk*>;
-	mesh_queue = new Queue<Chunk*>;
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-	active = true;
-	
-	while (active) {
+ChunkStage stageOf(ChunkJobType type)
+{
+	if (type == JOB_BUILD)
+		return STAGE_BUILD;
+	if (type == JOB_MESH)
+		return STAGE_MESH;
+	return STAGE_IO;
+}
 
-		bool action_done = false;
+void wakeWorker(StageQueues& stage)
+{
+	// The job is already in a queue, so a worker checking the queues under the lock either sees it or is notified
+	std::lock_guard<std::mutex> lock(stage.wake_mutex);
+	if (stage.sleeping_workers > 0)
+		stage.wake_signal.notify_one();
+}
 
-		if (!mesh_queue->isEmpty()) {
-			Chunk* chunk;
-			mesh_queue->dequeue(chunk);
-			remeshChunk(chunk);
-			action_done = true;
-		}
+void pushJob(ChunkJob job, bool urgent = false)
+{
+	StageQueues& stage = stages[stageOf(job.type)];
+	if (!stage.queues)
+		return;
+	job.queued_at = nowMicroseconds();
+	if (urgent) {
+		while (!stage.urgent.enqueue(job))
+			std::this_thread::yield();
+		wakeWorker(stage);
+		return;
+	}
+	// Queues are sized for every chunk having a job, so a full queue only means the round robin was unlucky
+	int first = stage.next_queue++ % stage.workers;
+	for (int i = 0; ; i = (i + 1) % stage.workers) {
+		if (stage.queues[(first + i) % stage.workers].enqueue(job))
+			break;
+		if (i == stage.workers - 1)
+			std::this_thread::yield();
+	}
+	wakeWorker(stage);
+}
+
+bool hasJob(StageQueues& stage)
+{
+	if (!stage.urgent.isEmpty())
+		return true;
+	for (int i = 0; i < stage.workers; i++) {
+		if (!stage.queues[i].isEmpty())
+			return true;
+	}
+	return false;
+}
+
+// Blocks until there may be a job to take, or the workers are stopped.
+void waitForJob(StageQueues& stage)
+{
+	std::unique_lock<std::mutex> lock(stage.wake_mutex);
+	stage.sleeping_workers++;
+	stage.wake_signal.wait(lock, [&stage] { return !active || hasJob(stage); });
+	stage.sleeping_workers--;
+}
+
+bool takeJob(StageQueues& stage, int worker, ChunkJob& job)
+{
+	if (stage.urgent.dequeue(job))
+		return true;
+	if (job_batch_next == job_batch_count) {
+		job_batch_count = stage.queues[worker].dequeueBatch(job_batch, JOB_BATCH);
+		job_batch_next = 0;
+	}
+	if (job_batch_next < job_batch_count) {
+		job = job_batch[job_batch_next++];
+		return true;
+	}
+	for (int i = 1; i < stage.workers; i++) {
+		if (stage.queues[(worker + i) % stage.workers].dequeue(job))
+			return true;
+	}
+	return false;
+}
 
-		if (!load_queue->isEmpty()) {
-			Chunk* chunk;
-			load_queue->dequeue(chunk);
-			loadOrGenerate(chunk);
-			action_done = true;
+// Returns false if the job was dropped (cancelled, or replaced by a newer job of the same chunk).
+// A load can be cancelled until its build job starts, the files read for a cancelled one are thrown away.
+bool runJob(const ChunkJob& job)
+{
+	switch (job.type) {
+	case JOB_LOAD:
+		if (!job.chunk->getLoadTicket()->isCurrent(job.ticket))
+			return false;
+		readChunkFiles(job);
+		return true;
+	case JOB_BUILD:
+		if (!job.chunk->getLoadTicket()->redeem(job.ticket)) {
+			MemoryPool::release(job.file);
+			MemoryPool::release(job.tfile);
+			return false;
 		}
+		buildChunk(job);
+		return true;
+	case JOB_MESH:
+		if (!job.chunk->getMeshTicket()->redeem(job.ticket))
+			return false;
+		meshChunkJob(job.chunk);
+		return true;
+	default:
+		saveAndFreeChunk(job.chunk);
+		return true;
+	}
+}
+
+// Scratch buffers of the calling thread for remeshChunk()
+void allocateMeshBuffers()
+{
+	mesh_buffer = new ChunkVertex[MESH_BUFFER_SIZE];
+	mesh_liquid_buffer = new ChunkVertex[MESH_LIQUID_BUFFER_SIZE];
+	face_masks = new unsigned int[MESH_FACES * CHUNK_SECTION_VOLUME]();
+	padded_blocks = new unsigned short int[PAD_SIZE * PAD_AREA]();
+}
+
+void freeMeshBuffers()
+{
+	delete[] mesh_buffer;
+	mesh_buffer = nullptr;
+	delete[] mesh_liquid_buffer;
+	mesh_liquid_buffer = nullptr;
+	delete[] face_masks;
+	face_masks = nullptr;
+	delete[] padded_blocks;
+	padded_blocks = nullptr;
+}
+
+int chunkManagerThread(int stage_index, int worker)
+{
+	StageQueues& stage = stages[stage_index];
+	if (stage_index == STAGE_MESH) {
+		allocateMeshBuffers();
+	}
+	else {
+		chunk_data_buffer = new unsigned short int[CHUNK_AREA * CHUNK_HEIGHT];
+	}
+
+	running_workers++;
+	ready_workers++;
+	
+	while (active) {
 
-		if (!save_queue->isEmpty()) {
-			Chunk* chunk;
-			save_queue->dequeue(chunk);
-			saveAndFreeChunk(chunk);
-			action_done = true;
+		ChunkJob job;
+		bool action_done = takeJob(stage, worker, job);
+
+		if (action_done) {
+			long long start = nowMicroseconds();
+			section_epochs.enter(stage.first_reader + worker);
+			bool done = runJob(job);
+			section_epochs.leave(stage.first_reader + worker);
+			if (done) {
+				stage.wait_time.add(start - job.queued_at);
+				stage.run_time.add(nowMicroseconds() - start);
+			}
+			else {
+				dropped_jobs++;
+			}
+			section_epochs.reclaim();
 		}
 
-		if (!action_done) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		if (!action_done) waitForJob(stage);
 	}
 
-	while (!save_queue->isEmpty()) {
-		Chunk* chunk;
-		save_queue->dequeue(chunk);
-		saveAndFreeChunk(chunk);
+	// Only the saves are done after saveAndKill()
+	ChunkJob job;
+	while (takeJob(stage, worker, job)) {
+		if (job.type == JOB_SAVE)
+			saveAndFreeChunk(job.chunk);
+		MemoryPool::release(job.file);
+		MemoryPool::release(job.tfile);
 	}
 
-	delete load_queue;
-	load_queue = nullptr;
-	delete save_queue;
-	save_queue = nullptr;
-	delete mesh_queue;
-	mesh_queue = nullptr;
+	delete[] chunk_data_buffer;
+	chunk_data_buffer = nullptr;
+	freeMeshBuffers();
+
+	if (--running_workers == 0) {
+		for (int s = 0; s < CHUNK_STAGES; s++) {
+			delete[] stages[s].queues;
+			stages[s].queues = nullptr;
+		}
+		ChunkSection::setReclaimer(nullptr);
+		section_epochs.reclaimAll();
+	}
 
 	return 0;
 }
 
-void chunk_thread::initManagerThread(const char* world_name, const char* save_addr, int seeds[16])
+void chunk_thread::initManagerThread(const char* world_name, const char* save_addr, int seeds[16], const int workers[CHUNK_STAGES], int queue_capacity)
 {
+	total_workers = 0;
+	for (int s = 0; s < CHUNK_STAGES; s++) {
+		stages[s].workers = workers[s];
+		stages[s].first_reader = total_workers;
+		stages[s].queues = new Queue<ChunkJob>[workers[s]];
+		for (int i = 0; i < workers[s]; i++)
+			stages[s].queues[i].initialize(queue_capacity);
+		stages[s].urgent.initialize(queue_capacity);
+		stages[s].wait_time.clear();
+		stages[s].run_time.clear();
+		total_workers += workers[s];
+	}
+	section_epochs.initialize(total_workers);
+	ChunkSection::setReclaimer(&section_epochs);
+
+	for (int i = 0; i < BLOCK_ID_RANGE; i++) {
+		unsigned short int block = (unsigned short int)i;
+		unsigned char classes = 0;
+		if (gamedata::blocks.hasTransparency(block)) classes |= 1 << CLASS_TRANSPARENT;
+		if (gamedata::blocks.isRenderable(block)) {
+			int model = gamedata::blocks.getModelType(block);
+			classes |= 1 << CLASS_RENDERABLE;
+			if (model == gamedata::MODEL_SOLID) classes |= 1 << CLASS_SOLID;
+			else if (model == gamedata::MODEL_LIQUID) classes |= 1 << CLASS_LIQUID;
+			else if (model == gamedata::MODEL_PLANT_2FACE || model == gamedata::MODEL_SURFACE_ONLY || model == gamedata::MODEL_PLANT_SURFACE_2FACE) classes |= 1 << CLASS_MODEL; // Meshed one by one
+		}
+		block_classes[i] = classes;
+	}
+	ready_workers = 0;
+	active = true;
+
 	{
 		// Average Area Temperature
 		noisegen[0].SetSeed(seeds[0]);
@@ -157,202 +435,636 @@ void chunk_thread::initManagerThread(const char* world_name, const char* save_ad
 void chunk_thread::enqueueLoadRequest(Chunk* chunk)
 {
 	chunk->setLoadRequested();
-	if (load_queue)
-		load_queue->enqueue(chunk);
+	pushJob({ JOB_LOAD, chunk, chunk->getLoadTicket()->issue(), 0, chunk->getChunkX(), chunk->getChunkZ() }, true);
+}
+
+bool chunk_thread::cancelLoadRequest(Chunk* chunk)
+{
+	if (!chunk->isLoadRequested() || !chunk->getLoadTicket()->cancel())
+		return false;
+	chunk->loadRequestCancelled();
+	return true;
 }
 
 void chunk_thread::enqueueSaveRequest(Chunk* chunk)
 {
 
 	chunk->setUnloadRequested();
-	if (save_queue)
-		save_queue->enqueue(chunk);
+	pushJob({ JOB_SAVE, chunk });
 }
 
-void chunk_thread::enqueueMeshRequest(Chunk* chunk)
+bool chunk_thread::enqueueMeshRequest(Chunk* chunk, bool urgent)
 {
-	chunk->setMeshUpdateRequested();
-	if (mesh_queue)
-		mesh_queue->enqueue(chunk);
+	JobTicket* ticket = chunk->getMeshTicket();
+	if (chunk->isMeshUpdateRequested()) {
+		// The queued job remeshes every section marked by the time it starts
+		if ((!urgent || chunk->isMeshRequestUrgent()) && ticket->isQueued()) {
+			merged_requests++;
+			return true;
+		}
+		// Moved to the urgent lane, the job left in the other queue is dropped
+		if (urgent && ticket->cancel()) {
+			merged_requests++;
+			chunk->setMeshUpdateRequested(true);
+			pushJob({ JOB_MESH, chunk, ticket->issue() }, true);
+			return true;
+		}
+		return false;
+	}
+	chunk->setMeshUpdateRequested(urgent);
+	pushJob({ JOB_MESH, chunk, ticket->issue() }, urgent);
+	return true;
 }
 
 void chunk_thread::saveAndKill(Chunk* chunklist, int len)
 {
 	for (int i = 0; i < len; i++) {
-		if (chunklist[i].isFree())
+		if (chunklist[i].isFree() || chunklist[i].isUnloadRequested()) // Already queued for saving
 			continue;
 		chunklist[i].setUnloadRequested();
-		if (save_queue)
-			save_queue->enqueue(&chunklist[i]);
+		pushJob({ JOB_SAVE, &chunklist[i] });
 	}
 	active = false;
+	for (int s = 0; s < CHUNK_STAGES; s++) {
+		std::lock_guard<std::mutex> lock(stages[s].wake_mutex);
+		stages[s].wake_signal.notify_all();
+	}
 }
 
 bool chunk_thread::isInitialized()
 {
-	return active;
+	return active && ready_workers == total_workers;
+}
+
+unsigned long long chunk_thread::getDroppedJobs()
+{
+	return dropped_jobs;
+}
+
+unsigned long long chunk_thread::getMergedRequests()
+{
+	return merged_requests;
+}
+
+unsigned long long chunk_thread::getStaleMeshes()
+{
+	return stale_meshes;
+}
+
+unsigned long long chunk_thread::getMeshedSections()
+{
+	return meshed_sections;
+}
+
+void chunk_thread::setGreedyMeshing(bool enabled)
+{
+	greedy_meshing = enabled;
+}
+
+void chunk_thread::setBitPlaneCulling(bool enabled)
+{
+	bit_plane_culling = enabled;
+}
+
+void chunk_thread::setEdgeOnlyInvalidation(bool enabled)
+{
+	edge_only_invalidation = enabled;
 }
 
-void loadOrGenerate(Chunk* chunk)
+MeshBenchmarkResult chunk_thread::benchmarkMeshing(int radius, int passes)
 {
-	int well = CHUNK_AREA * CHUNK_HEIGHT;
+	int side = radius * 2 + 1;
+	Chunk* chunks = new Chunk[side * side];
+	unsigned short int* data = new unsigned short int[CHUNK_AREA * CHUNK_HEIGHT];
+	for (int i = 0; i < side * side; i++) {
+		Chunk* chunk = &chunks[i];
+		chunk->init(i / side - radius, i % side - radius);
+		chunk->public_chunk_time_stamp = { 0, 0, 600.0f };
+		generateChunk(data, ChunkShape<CHUNK_SIZE, CHUNK_HEIGHT>(), chunk->getChunkX() * CHUNK_SIZE, chunk->getChunkZ() * CHUNK_SIZE, chunk->public_chunk_time_stamp, chunk->getTickableBlocksPointer());
+		chunk->loadRequestResponse(data);
+	}
+	delete[] data;
+
+	std::vector<Chunk*> meshed;
+	for (int x = 1; x < side - 1; x++) {
+		for (int z = 1; z < side - 1; z++) {
+			Chunk* chunk = &chunks[x * side + z];
+			chunk->setAroundChunkPointers(&chunks[(x - 1) * side + z], &chunks[(x + 1) * side + z], &chunks[x * side + z - 1], &chunks[x * side + z + 1]);
+			meshed.push_back(chunk);
+		}
+	}
+
+	allocateMeshBuffers();
+	long long start = nowMicroseconds();
+	for (int pass = 0; pass < passes; pass++) {
+		for (Chunk* chunk : meshed) {
+			Chunk* around[4] = { chunk->getChunkPointerOnXN(), chunk->getChunkPointerOnXP(), chunk->getChunkPointerOnZN(), chunk->getChunkPointerOnZP() };
+			ChunkSnapshot own;
+			ChunkSnapshot snapshots[4];
+			const ChunkSnapshot* nearby[4];
+			chunk->takeSnapshot(own);
+			for (int n = 0; n < 4; n++) {
+				around[n]->takeSnapshot(snapshots[n]);
+				nearby[n] = &snapshots[n];
+			}
+			remeshChunk(chunk, ~0u, &own, nearby);
+			chunk->releaseSnapshot(own);
+			for (int n = 0; n < 4; n++)
+				around[n]->releaseSnapshot(snapshots[n]);
+		}
+	}
+	long long time = nowMicroseconds() - start;
+	freeMeshBuffers();
+
+	MeshBenchmarkResult result;
+	result.chunks = (int)meshed.size();
+	result.passes = passes;
+	result.vertices = 0;
+	result.vertex_hash = 14695981039346656037ull;
+	for (Chunk* chunk : meshed) {
+		for (int i = 0; i < CHUNK_SECTIONS; i++) {
+			int size = chunk->_verticalChunkSize()[i];
+			const unsigned char* bytes = (const unsigned char*)chunk->_verticalChunkData()[i];
+			for (size_t b = 0; b < size * sizeof(ChunkVertex); b++)
+				result.vertex_hash = (result.vertex_hash ^ bytes[b]) * 1099511628211ull;
+			result.vertices += size;
+		}
+	}
+	result.microseconds_per_chunk = (meshed.empty() || passes <= 0) ? 0.0 : (double)time / (meshed.size() * passes);
+
+	for (int i = 0; i < side * side; i++)
+		chunks[i].wipe();
+	delete[] chunks;
+	return result;
+}
+
+const LatencyHistogram* chunk_thread::getStageWaitTimes(ChunkStage stage)
+{
+	return &stages[stage].wait_time;
+}
+
+const LatencyHistogram* chunk_thread::getStageRunTimes(ChunkStage stage)
+{
+	return &stages[stage].run_time;
+}
+
+// IO stage: only reads the chunk files, the build stage decodes them (or generates the chunk if it was never saved)
+void readChunkFiles(ChunkJob job)
+{
+	ChunkDataFile cdf = ChunkDataFile(path);
+	job.type = JOB_BUILD;
+	job.file = cdf.readChunkData(job.chunk_x, job.chunk_z, job.file_size);
+	job.tfile = job.file ? cdf.readChunkTData(job.chunk_x, job.chunk_z, job.tfile_size) : nullptr;
+	pushJob(job);
+}
+
+void buildChunk(const ChunkJob& job)
+{
+	Chunk* chunk = job.chunk;
 	int cstx = chunk->getChunkX() * 16;
 	int cstz = chunk->getChunkZ() * 16;
-	unsigned short int* data = new unsigned short int[well];
+	unsigned short int* data = chunk_data_buffer;
 
-	ChunkDataFile cdf = ChunkDataFile(path);
-	if (cdf.loadChunkData(data, chunk->getChunkX(), chunk->getChunkZ(), CHUNK_SIZE, CHUNK_HEIGHT)) {
+	if (job.file) {
+		ChunkDataFile::decodeChunkData(job.file, job.file_size, data, ChunkShape<CHUNK_SIZE, CHUNK_HEIGHT>());
 		TickableBlock* tbdat = nullptr;
-		size_t ln = cdf.loadChunkTData(&tbdat, chunk->getChunkX(), chunk->getChunkZ());
-		if(tbdat && ln != 0)
+		size_t ln = ChunkDataFile::decodeChunkTData(job.tfile, job.tfile_size, &tbdat);
+		if(tbdat)
 		{
 			for (int i = 0; i < ln; i++)
-				chunk->getTickableBlocksPointer()->push_back(tbdat[i]);
+				chunk->getTickableBlocksPointer()->add(tbdat[i]);
 			delete[] tbdat;
 		}
+		MemoryPool::release(job.file);
+		MemoryPool::release(job.tfile);
 		chunk->loadRequestResponse(data);
 		return;
 	}
 
-	generateChunk(data, CHUNK_SIZE, CHUNK_HEIGHT, cstx, cstz, chunk->public_chunk_time_stamp);
-	generateTickableChunkBlocks(chunk->getTickableBlocksPointer(), data, CHUNK_SIZE, CHUNK_HEIGHT);
+	generateChunk(data, ChunkShape<CHUNK_SIZE, CHUNK_HEIGHT>(), cstx, cstz, chunk->public_chunk_time_stamp, chunk->getTickableBlocksPointer());
 	chunk->loadRequestResponse(data);
 }
 
-void createTopFace(float* dst, int x, int y, int z, int highest, float s, unsigned short int block, float max_y = 1.0f) {
-	float light = (y >= highest) ? 1.0f : 0.5f;
-	float sa, sb;
-	int blt = gamedata::blocks.indexer[block]->getBlockTexture(gamedata::DIRECTION_TOP);
-	sa = s * (blt / 32); 
-	sb = s * (blt % 32);
-	float cv[] = {
-		x    , y + max_y, z    , sb    , sa + s, light,
-		x + 1, y + max_y, z + 1, sb + s, sa    , light,
-		x    , y + max_y, z + 1, sb    , sa    , light,
-		x    , y + max_y, z    , sb    , sa + s, light,
-		x + 1, y + max_y, z    , sb + s, sa + s, light,
-		x + 1, y + max_y, z + 1, sb + s, sa    , light
-	};
-	memcpy(dst, cv, 36 * sizeof(float));
+// The face writers below write quads of 4 ChunkVertex in the corner order of the shared index buffer (triangles 0 1 2 and 0 3 1).
+// They take the face size in blocks: 'w' along x, 'd' along z and 'h' along y. Faces with a lower top ('top' other than VERTEX_TOP_WHOLE) are one block high.
+// Texture coordinates are the position inside the face in blocks, the terrain shader repeats the block's atlas tile over merged faces.
+
+// Whole block part of the top edge of a face 'h' blocks high from 'y', the shader adds the 'top' offset
+int faceTop(int y, int h, int top)
+{
+	return (top == VERTEX_TOP_WHOLE) ? y + h : y + h - 1;
 }
 
-void createBottomFace(float* dst, int x, int y, int z, int highest, float s, unsigned short int block) {
+void createTopFace(ChunkVertex* dst, int x, int y, int z, bool lit, unsigned short int block, int top = VERTEX_TOP_WHOLE, int w = 1, int d = 1) {
+	float light = lit ? 1.0f : 0.5f;
+	int tile = gamedata::blocks.getBlockTexture(block, gamedata::DIRECTION_TOP);
+	int ty = faceTop(y, 1, top);
+	dst[0] = ChunkVertex::pack(x    , ty, z    , tile, 0, d, light, 0, 0, top);
+	dst[1] = ChunkVertex::pack(x + w, ty, z + d, tile, w, 0, light, 0, 0, top);
+	dst[2] = ChunkVertex::pack(x    , ty, z + d, tile, 0, 0, light, 0, 0, top);
+	dst[3] = ChunkVertex::pack(x + w, ty, z    , tile, w, d, light, 0, 0, top);
+}
+
+void createBottomFace(ChunkVertex* dst, int x, int y, int z, unsigned short int block, int w = 1, int d = 1) {
 	float light = 0.3f;
-	float sa, sb;
-	int blt = gamedata::blocks.indexer[block]->getBlockTexture(gamedata::DIRECTION_BOTTOM);
-	sa = s * (blt / 32);
-	sb = s * (blt % 32);
-	float cv[] = {
-		x    , y    , z    , sb    , sa + s, light,
-		x + 1, y    , z + 1, sb + s, sa    , light,
-		x    , y    , z + 1, sb    , sa    , light,
-		x    , y    , z    , sb    , sa + s, light,
-		x + 1, y    , z    , sb + s, sa + s, light,
-		x + 1, y    , z + 1, sb + s, sa    , light
-	};
-	memcpy(dst, cv, 36 * sizeof(float));
-}
-
-void createNegativeXFace(float* dst, int x, int y, int z, int highest, float s, unsigned short int block, float max_y = 1.0f) {
-	float light = (y >= highest) ? 0.8f : 0.4f;
-	float sa, sb;
-	int blt = gamedata::blocks.indexer[block]->getBlockTexture(gamedata::DIRECTION_NEGATIVE_X);
-	sa = s * (blt / 32);
-	sb = s * (blt % 32);
-	float cv[] = {
-		x    , y + max_y, z    , sb + s, sa    , light,
-		x    , y    , z    , sb + s, sa + s, light,
-		x    , y + max_y, z + 1, sb    , sa    , light,
-		x    , y + max_y, z + 1, sb    , sa    , light,
-		x    , y    , z    , sb + s, sa + s, light,
-		x    , y    , z + 1, sb    , sa + s, light
-	};
-	memcpy(dst, cv, 36 * sizeof(float));
-}
-
-void createPositiveXFace(float* dst, int x, int y, int z, int highest, float s, unsigned short int block, float max_y = 1.0f) {
-	float light = (y >= highest) ? 0.8f : 0.4f;
-	float sa, sb;
-	int blt = gamedata::blocks.indexer[block]->getBlockTexture(gamedata::DIRECTION_POSITIVE_X);
-	sa = s * (blt / 32);
-	sb = s * (blt % 32);
-	float cv[] = {
-		x + 1, y + max_y, z    , sb + s, sa    , light,
-		x + 1, y    , z    , sb + s, sa + s, light,
-		x + 1, y + max_y, z + 1, sb    , sa    , light,
-		x + 1, y + max_y, z + 1, sb    , sa    , light,
-		x + 1, y    , z    , sb + s, sa + s, light,
-		x + 1, y    , z + 1, sb    , sa + s, light
-	};
-	memcpy(dst, cv, 36 * sizeof(float));
-}
-
-void createNegativeZFace(float* dst, int x, int y, int z, int highest, float s, unsigned short int block, float max_y = 1.0f) {
-	float light = (y >= highest) ? 0.7f : 0.35f;
-	float sa, sb;
-	int blt = gamedata::blocks.indexer[block]->getBlockTexture(gamedata::DIRECTION_NEGATIVE_Z);
-	sa = s * (blt / 32);
-	sb = s * (blt % 32);
-	float cv[] = {
-		x + 1, y + max_y, z    , sb + s, sa    , light,
-		x    , y    , z    , sb    , sa + s, light,
-		x    , y + max_y, z    , sb    , sa    , light,
-		x + 1, y    , z    , sb + s, sa + s, light,
-		x    , y    , z    , sb    , sa + s, light,
-		x + 1, y + max_y, z    , sb + s, sa    , light
-	};
-	memcpy(dst, cv, 36 * sizeof(float));
-}
-
-void createPositiveZFace(float* dst, int x, int y, int z, int highest, float s, unsigned short int block, float max_y = 1.0f) {
-	float light = (y >= highest) ? 0.7f : 0.35f;
-	float sa, sb;
-	int blt = gamedata::blocks.indexer[block]->getBlockTexture(gamedata::DIRECTION_POSITIVE_Z);
-	sa = s * (blt / 32);
-	sb = s * (blt % 32);
-	float cv[] = {
-		x + 1, y + max_y, z + 1, sb + s, sa    , light,
-		x    , y    , z + 1, sb    , sa + s, light,
-		x    , y + max_y, z + 1, sb    , sa    , light,
-		x + 1, y    , z + 1, sb + s, sa + s, light,
-		x    , y    , z + 1, sb    , sa + s, light,
-		x + 1, y + max_y, z + 1, sb + s, sa    , light
+	int tile = gamedata::blocks.getBlockTexture(block, gamedata::DIRECTION_BOTTOM);
+	dst[0] = ChunkVertex::pack(x    , y, z    , tile, 0, d, light);
+	dst[1] = ChunkVertex::pack(x + w, y, z + d, tile, w, 0, light);
+	dst[2] = ChunkVertex::pack(x    , y, z + d, tile, 0, 0, light);
+	dst[3] = ChunkVertex::pack(x + w, y, z    , tile, w, d, light);
+}
+
+void createXFace(ChunkVertex* dst, int x, int y, int z, float light, int tile, int top, int d, int h) {
+	int ty = faceTop(y, h, top);
+	dst[0] = ChunkVertex::pack(x, y , z    , tile, d, h, light);
+	dst[1] = ChunkVertex::pack(x, ty, z + d, tile, 0, 0, light, 0, 0, top);
+	dst[2] = ChunkVertex::pack(x, ty, z    , tile, d, 0, light, 0, 0, top);
+	dst[3] = ChunkVertex::pack(x, y , z + d, tile, 0, h, light);
+}
+
+void createNegativeXFace(ChunkVertex* dst, int x, int y, int z, bool lit, unsigned short int block, int top = VERTEX_TOP_WHOLE, int d = 1, int h = 1) {
+	createXFace(dst, x, y, z, lit ? 0.8f : 0.4f, gamedata::blocks.getBlockTexture(block, gamedata::DIRECTION_NEGATIVE_X), top, d, h);
+}
+
+void createPositiveXFace(ChunkVertex* dst, int x, int y, int z, bool lit, unsigned short int block, int top = VERTEX_TOP_WHOLE, int d = 1, int h = 1) {
+	createXFace(dst, x + 1, y, z, lit ? 0.8f : 0.4f, gamedata::blocks.getBlockTexture(block, gamedata::DIRECTION_POSITIVE_X), top, d, h);
+}
+
+void createZFace(ChunkVertex* dst, int x, int y, int z, float light, int tile, int top, int w, int h) {
+	int ty = faceTop(y, h, top);
+	dst[0] = ChunkVertex::pack(x + w, ty, z, tile, w, 0, light, 0, 0, top);
+	dst[1] = ChunkVertex::pack(x    , y , z, tile, 0, h, light);
+	dst[2] = ChunkVertex::pack(x    , ty, z, tile, 0, 0, light, 0, 0, top);
+	dst[3] = ChunkVertex::pack(x + w, y , z, tile, w, h, light);
+}
+
+void createNegativeZFace(ChunkVertex* dst, int x, int y, int z, bool lit, unsigned short int block, int top = VERTEX_TOP_WHOLE, int w = 1, int h = 1) {
+	createZFace(dst, x, y, z, lit ? 0.7f : 0.35f, gamedata::blocks.getBlockTexture(block, gamedata::DIRECTION_NEGATIVE_Z), top, w, h);
+}
+
+void createPositiveZFace(ChunkVertex* dst, int x, int y, int z, bool lit, unsigned short int block, int top = VERTEX_TOP_WHOLE, int w = 1, int h = 1) {
+	createZFace(dst, x, y, z + 1, lit ? 0.7f : 0.35f, gamedata::blocks.getBlockTexture(block, gamedata::DIRECTION_POSITIVE_Z), top, w, h);
+}
+
+// Two crossed quads 1/7 block inside the block's sides
+void createDiagonalFaces(ChunkVertex* dst, int x, int y, int z, bool lit, unsigned short int block) {
+	constexpr int le = VERTEX_SIDE_FAR; // 6/7
+	constexpr int he = VERTEX_SIDE_NEAR; // 1/7
+	float light = lit ? 0.7f : 0.35f;
+	int tile = gamedata::blocks.getBlockTexture(block, gamedata::DIRECTION_POSITIVE_Z);
+	dst[0] = ChunkVertex::pack(x, y + 1, z, tile, 1, 0, light, he, le);
+	dst[1] = ChunkVertex::pack(x, y    , z, tile, 0, 1, light, le, he);
+	dst[2] = ChunkVertex::pack(x, y + 1, z, tile, 0, 0, light, le, he);
+	dst[3] = ChunkVertex::pack(x, y    , z, tile, 1, 1, light, he, le);
+
+	dst[4] = ChunkVertex::pack(x, y + 1, z, tile, 1, 0, light, he, he);
+	dst[5] = ChunkVertex::pack(x, y    , z, tile, 0, 1, light, le, le);
+	dst[6] = ChunkVertex::pack(x, y + 1, z, tile, 0, 0, light, le, le);
+	dst[7] = ChunkVertex::pack(x, y    , z, tile, 1, 1, light, he, he);
+}
+
+// Marks the face 'face' (one of MeshFace) of the block at (x, y, z) in the section being meshed, see writeFaces().
+void markFace(int face, int x, int y, int z, unsigned short int block, bool lit)
+{
+	face_masks[face * CHUNK_SECTION_VOLUME + (y % CHUNK_SIZE) * CHUNK_AREA + x * CHUNK_SIZE + z] = ((unsigned int)block << 1 | (lit ? 1u : 0u)) + 1;
+}
+
+// Writes the faces marked in vertical section 'section' and clears the marks. Liquid faces go to 'liquid', the rest to 'solid'.
+// With 'greedy', faces next to each other with the same block and light are merged into one quad: first along a row, then rows of the same length.
+// 'face_rows' has the marked faces as bits (see cullFaces()), lines without any are skipped.
+void writeFaces(int section, bool greedy, const FaceRow* face_rows, ChunkVertex* solid, int& solid_size, ChunkVertex* liquid, int& liquid_size)
+{
+	for (int face = 0; face < MESH_FACES; face++) {
+		unsigned int* mask = &face_masks[face * CHUNK_SECTION_VOLUME];
+		const FaceRow* rows = &face_rows[face * CHUNK_AREA];
+		unsigned int layer_bits[CHUNK_SIZE]; // Bit z is set if any face of layer y is at z
+		unsigned int any = 0;
+		for (int y = 0; y < CHUNK_SIZE; y++) {
+			layer_bits[y] = 0;
+			for (int x = 0; x < CHUNK_SIZE; x++)
+				layer_bits[y] |= rows[y * CHUNK_SIZE + x];
+			any |= layer_bits[y];
+		}
+		if (!any)
+			continue;
+
+		// A slice is a plane of faces, rows run along 'a'
+		int slice_stride, a_stride, b_stride;
+		if (face == FACE_BOTTOM || face == FACE_TOP) {
+			slice_stride = CHUNK_AREA; a_stride = CHUNK_SIZE; b_stride = 1; // y, x, z
+		}
+		else if (face == FACE_XN || face == FACE_XP) {
+			slice_stride = CHUNK_SIZE; a_stride = 1; b_stride = CHUNK_AREA; // x, z, y
+		}
+		else {
+			slice_stride = 1; a_stride = CHUNK_SIZE; b_stride = CHUNK_AREA; // z, x, y
+		}
+
+		for (int slice = 0; slice < CHUNK_SIZE; slice++) {
+			for (int b = 0; b < CHUNK_SIZE; b++) {
+				bool has_faces;
+				if (face == FACE_BOTTOM || face == FACE_TOP)
+					has_faces = (layer_bits[slice] >> b) & 1; // y, z
+				else if (face == FACE_XN || face == FACE_XP)
+					has_faces = rows[b * CHUNK_SIZE + slice] != 0; // y, x
+				else
+					has_faces = (layer_bits[b] >> slice) & 1; // y, z
+				if (!has_faces)
+					continue;
+				for (int a = 0; a < CHUNK_SIZE; a++) {
+					unsigned int* cell = &mask[slice * slice_stride + b * b_stride + a * a_stride];
+					unsigned int key = *cell;
+					if (!key)
+						continue;
+					unsigned short int block = (unsigned short int)((key - 1) >> 1);
+					bool lit = (key - 1) & 1;
+					bool is_liquid = gamedata::blocks.getModelType(block) == gamedata::MODEL_LIQUID;
+
+					int width = 1;
+					int height = 1;
+					if (greedy) {
+						while (a + width < CHUNK_SIZE && cell[width * a_stride] == key)
+							width++;
+						// Liquid sides are lower than a block, stacked ones are not merged
+						bool stackable = !is_liquid || face == FACE_BOTTOM || face == FACE_TOP;
+						while (stackable && b + height < CHUNK_SIZE) {
+							unsigned int* row = cell + height * b_stride;
+							int i = 0;
+							while (i < width && row[i * a_stride] == key)
+								i++;
+							if (i < width)
+								break;
+							height++;
+						}
+					}
+					for (int j = 0; j < height; j++)
+						for (int i = 0; i < width; i++)
+							cell[j * b_stride + i * a_stride] = 0;
+
+					ChunkVertex* dst = is_liquid ? &liquid[liquid_size] : &solid[solid_size];
+					int& size = is_liquid ? liquid_size : solid_size;
+					if (size + 4 > (is_liquid ? MESH_LIQUID_BUFFER_SIZE : MESH_BUFFER_SIZE)) // Almost impossible, just in case
+						continue;
+					int top = is_liquid ? VERTEX_TOP_LIQUID : VERTEX_TOP_WHOLE;
+					int y0 = section * CHUNK_SIZE;
+					switch (face) {
+					case FACE_BOTTOM: createBottomFace(dst, a, y0 + slice, b, block, width, height); break;
+					case FACE_TOP: createTopFace(dst, a, y0 + slice, b, lit, block, top, width, height); break;
+					case FACE_XN: createNegativeXFace(dst, slice, y0 + b, a, lit, block, top, width, height); break;
+					case FACE_XP: createPositiveXFace(dst, slice, y0 + b, a, lit, block, top, width, height); break;
+					case FACE_ZN: createNegativeZFace(dst, a, y0 + b, slice, lit, block, top, width, height); break;
+					default: createPositiveZFace(dst, a, y0 + b, slice, lit, block, top, width, height); break;
+					}
+					size += 4;
+				}
+			}
+		}
+	}
+}
+
+// Pins a nearby chunk for reading during a mesh job, nullptr if it is not there or is about to be unloaded
+Chunk* pinNeighbor(Chunk* neighbor, int chunk_x, int chunk_z)
+{
+	if (!neighbor || !neighbor->pin())
+		return nullptr;
+	if (neighbor->isFree() || !neighbor->isDataAvailable() || neighbor->getChunkX() != chunk_x || neighbor->getChunkZ() != chunk_z) {
+		neighbor->unpin();
+		return nullptr;
+	}
+	return neighbor;
+}
+
+void meshChunkJob(Chunk* chunk)
+{
+	// Taken before looking at the nearby chunks, a chunk which shows up later marks it again
+	unsigned int sections = chunk->takeDirtySections();
+	chunk->clearMeshedNeighbors();
+
+	int cx = chunk->getChunkX();
+	int cz = chunk->getChunkZ();
+	Chunk* xn = pinNeighbor(chunk->getChunkPointerOnXN(), cx - 1, cz);
+	Chunk* xp = pinNeighbor(chunk->getChunkPointerOnXP(), cx + 1, cz);
+	Chunk* zn = pinNeighbor(chunk->getChunkPointerOnZN(), cx, cz - 1);
+	Chunk* zp = pinNeighbor(chunk->getChunkPointerOnZP(), cx, cz + 1);
+	chunk->setAroundChunkPointers(xn, xp, zn, zp);
+	chunk->addMeshedNeighbors((xn ? Chunk::NEARBY_XN : 0) | (xp ? Chunk::NEARBY_XP : 0) | (zn ? Chunk::NEARBY_ZN : 0) | (zp ? Chunk::NEARBY_ZP : 0));
+
+	// The main thread keeps editing while we mesh, it writes copies of the sections we hold. Sections edited meanwhile are meshed again from new snapshots.
+	Chunk* pinned[4] = { xn, xp, zn, zp };
+	ChunkSnapshot own;
+	ChunkSnapshot around[4];
+	for (int attempt = 0; ; attempt++) {
+		const ChunkSnapshot* nearby[4];
+		chunk->takeSnapshot(own);
+		for (int i = 0; i < 4; i++) {
+			nearby[i] = nullptr;
+			if (pinned[i]) {
+				pinned[i]->takeSnapshot(around[i]);
+				nearby[i] = &around[i];
+			}
+		}
+
+		remeshChunk(chunk, sections, &own, nearby);
+
+		unsigned int stale = chunk->getSectionsChangedSince(own);
+		chunk->releaseSnapshot(own);
+		for (int i = 0; i < 4; i++)
+			if (pinned[i])
+				pinned[i]->releaseSnapshot(around[i]);
+
+		if (!stale || attempt == MESH_STALE_RETRIES)
+			break;
+		stale_meshes++;
+		sections = stale | chunk->takeDirtySections();
+	}
+	chunk->meshRequestResponse();
+
+	if (xn) xn->unpin();
+	if (xp) xp->unpin();
+	if (zn) zn->unpin();
+	if (zp) zp->unpin();
+}
+
+// Index of local block (x, y, z) of the section in padded_blocks, from -1 to CHUNK_SIZE on each axis
+inline int padIndex(int x, int y, int z)
+{
+	return (y + 1) * PAD_AREA + (x + 1) * PAD_SIZE + (z + 1);
+}
+
+// Copies vertical section 'section' of the snapshot and the blocks next to its six sides into 'padded', so the face tests are plain offsets (the edges and corners of the border are not filled).
+// Below the world and missing nearby chunks count as solid (stone), above the world is air.
+void gatherSection(const ChunkSnapshot* snapshot, const ChunkSnapshot* const nearby[4], int section, unsigned short int* padded)
+{
+	const unsigned short int stone = gamedata::blocks.stone.getID();
+	const unsigned short int air = gamedata::blocks.air.getID();
+
+	snapshot->unpackSection(section, &padded[padIndex(0, 0, 0)], PAD_SIZE, PAD_AREA);
+
+	for (int x = 0; x < CHUNK_SIZE; x++) {
+		for (int z = 0; z < CHUNK_SIZE; z++) {
+			padded[padIndex(x, -1, z)] = section > 0 ? snapshot->getSectionBlock(section - 1, (CHUNK_SIZE - 1) * CHUNK_AREA + x * CHUNK_SIZE + z) : stone;
+			padded[padIndex(x, CHUNK_SIZE, z)] = section < CHUNK_SECTIONS - 1 ? snapshot->getSectionBlock(section + 1, x * CHUNK_SIZE + z) : air;
+		}
+	}
+
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		for (int i = 0; i < CHUNK_SIZE; i++) {
+			int layer = y * CHUNK_AREA;
+			padded[padIndex(-1, y, i)] = nearby[0] ? nearby[0]->getSectionBlock(section, layer + (CHUNK_SIZE - 1) * CHUNK_SIZE + i) : stone;
+			padded[padIndex(CHUNK_SIZE, y, i)] = nearby[1] ? nearby[1]->getSectionBlock(section, layer + i) : stone;
+			padded[padIndex(i, y, -1)] = nearby[2] ? nearby[2]->getSectionBlock(section, layer + i * CHUNK_SIZE + CHUNK_SIZE - 1) : stone;
+			padded[padIndex(i, y, CHUNK_SIZE)] = nearby[3] ? nearby[3]->getSectionBlock(section, layer + i * CHUNK_SIZE) : stone;
+		}
+	}
+}
+
+// Index of the lowest set bit of 'bits' (not zero)
+inline int lowestBit(unsigned int bits)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(bits);
+#else
+	int i = 0;
+	while (!(bits & 1)) {
+		bits >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+// Finds the visible faces of the section in 'padded' (see gatherSection()) with bit operations on whole rows instead of testing every block and side.
+// Solid blocks show a face next to a block with transparency, liquids next to a block which is not renderable. 'face_rows' gets MESH_FACES * CHUNK_AREA rows of faces,
+// 'model_rows' gets the renderable blocks of the other models which are meshed one by one (plants and surfaces).
+// If not nullptr, 'nearby_faces' gets the sides (Chunk::NEARBY_* bits) where the border blocks of the nearby chunk show a face toward this section.
+void cullFaces(const unsigned short int* padded, FaceRow* face_rows, FaceRow* model_rows, unsigned int* nearby_faces)
+{
+	// Rows of the padded section for each BlockClass bit, bit z + 1 for block z (the border is bit 0 and bit CHUNK_SIZE + 1)
+	unsigned int planes[BLOCK_CLASSES][PAD_AREA];
+
+	for (int row = 0; row < PAD_AREA; row++) {
+		const unsigned short int* blocks = &padded[row * PAD_SIZE];
+		unsigned char classes[PAD_SIZE];
+		for (int z = 0; z < PAD_SIZE; z++)
+			classes[z] = block_classes[blocks[z]];
+#if defined(__SSE2__) && CHUNK_SIZE == 16
+		// One bit of each of the 16 inner classes to the top of its byte, then gathered into a 16 bit mask
+		__m128i inner = _mm_loadu_si128((const __m128i*)&classes[1]);
+		for (int c = 0; c < BLOCK_CLASSES; c++) {
+			unsigned int bits = (unsigned int)_mm_movemask_epi8(_mm_slli_epi16(inner, 7 - c));
+			planes[c][row] = (classes[0] >> c & 1u) | bits << 1 | (unsigned int)(classes[PAD_SIZE - 1] >> c & 1u) << (PAD_SIZE - 1);
+		}
+#else
+		for (int c = 0; c < BLOCK_CLASSES; c++) {
+			unsigned int bits = 0;
+			for (int z = 0; z < PAD_SIZE; z++)
+				bits |= (classes[z] >> c & 1u) << z;
+			planes[c][row] = bits;
+		}
+#endif
+	}
+
+	const unsigned int* transparent = planes[CLASS_TRANSPARENT];
+	const unsigned int* renderable = planes[CLASS_RENDERABLE];
+	const unsigned int row_bits = (1u << CHUNK_SIZE) - 1;
+	// The neighbor rows of each face and the shift which makes bit z the neighbor of block z
+	const int sides[MESH_FACES] = { -PAD_SIZE, PAD_SIZE, -1, 1, 0, 0 };
+	const int shifts[MESH_FACES] = { 1, 1, 1, 1, 0, 2 };
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			int center = (y + 1) * PAD_SIZE + x + 1;
+			int row = y * CHUNK_SIZE + x;
+			unsigned int solid = planes[CLASS_SOLID][center] >> 1;
+			unsigned int liquid = planes[CLASS_LIQUID][center] >> 1;
+			for (int face = 0; face < MESH_FACES; face++) {
+				unsigned int open = transparent[center + sides[face]] >> shifts[face];
+				unsigned int empty = ~renderable[center + sides[face]] >> shifts[face];
+				face_rows[face * CHUNK_AREA + row] = (FaceRow)(((solid & open) | (liquid & empty)) & row_bits);
+			}
+			model_rows[row] = (FaceRow)(planes[CLASS_MODEL][center] >> 1 & row_bits);
+		}
+	}
+	if (!nearby_faces)
+		return;
+
+	// Same test from the other side: border block 'outer' (bit 'outer_bit' of its row) facing block 'inner' of the section
+	auto shows = [&](int outer, int outer_bit, int inner, int inner_bit) -> unsigned int {
+		unsigned int open = transparent[inner] >> inner_bit;
+		unsigned int empty = ~renderable[inner] >> inner_bit;
+		return (planes[CLASS_SOLID][outer] >> outer_bit & open) | (planes[CLASS_LIQUID][outer] >> outer_bit & empty);
 	};
-	memcpy(dst, cv, 36 * sizeof(float));
-}
-
-void createDiagonalFaces(float* dst, int x, int y, int z, int highest, float s, unsigned short int block) {
-	constexpr float le = 0.8571428657f; // Lower Bound
-	constexpr float he = 0.1428571492f; // Upper Bound
-	float light = (y >= highest) ? 0.7f : 0.35f;
-	float sa, sb;
-	int blt = gamedata::blocks.indexer[block]->getBlockTexture(gamedata::DIRECTION_POSITIVE_Z);
-	sa = s * (blt / 32);
-	sb = s * (blt % 32);
-	float cv[] = {
-		x + he, y + 1, z + le, sb + s, sa    , light,
-		x + le, y    , z + he, sb    , sa + s, light,
-		x + le, y + 1, z + he, sb    , sa    , light,
-		x + he, y    , z + le, sb + s, sa + s, light,
-		x + le, y    , z + he, sb    , sa + s, light,
-		x + he, y + 1, z + le, sb + s, sa    , light,
-
-		x + he, y + 1, z + he, sb + s, sa    , light,
-		x + le, y    , z + le, sb    , sa + s, light,
-		x + le, y + 1, z + le, sb    , sa    , light,
-		x + he, y    , z + he, sb + s, sa + s, light,
-		x + le, y    , z + le, sb    , sa + s, light,
-		x + he, y + 1, z + he, sb + s, sa    , light
+	unsigned int xn = 0, xp = 0, zn = 0, zp = 0;
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		int layer = (y + 1) * PAD_SIZE;
+		xn |= shows(layer, 1, layer + 1, 1) & row_bits;
+		xp |= shows(layer + PAD_SIZE - 1, 1, layer + PAD_SIZE - 2, 1) & row_bits;
+		for (int x = 1; x <= CHUNK_SIZE; x++) {
+			zn |= shows(layer + x, 0, layer + x, 1) & 1u;
+			zp |= shows(layer + x, PAD_SIZE - 1, layer + x, PAD_SIZE - 2) & 1u;
+		}
+	}
+	*nearby_faces = (xn ? Chunk::NEARBY_XN : 0) | (xp ? Chunk::NEARBY_XP : 0) | (zn ? Chunk::NEARBY_ZN : 0) | (zp ? Chunk::NEARBY_ZP : 0);
+}
+
+// Same as cullFaces(), but tests every block and side one by one with the gamedata::blocks lookups. Used when bit plane culling is off (see chunk_thread::setBitPlaneCulling()).
+void cullFacesPerBlock(const unsigned short int* padded, FaceRow* face_rows, FaceRow* model_rows, unsigned int* nearby_faces)
+{
+	// Whether 'block' shows its face toward 'next'
+	auto shows = [](unsigned short int block, unsigned short int next) -> bool {
+		if (!gamedata::blocks.isRenderable(block))
+			return false;
+		int model = gamedata::blocks.getModelType(block);
+		if (model == gamedata::MODEL_SOLID)
+			return gamedata::blocks.hasTransparency(next);
+		if (model == gamedata::MODEL_LIQUID)
+			return !gamedata::blocks.isRenderable(next);
+		return false;
 	};
-	memcpy(dst, cv, 72 * sizeof(float));
+	// The neighbor of each face in 'padded'
+	const int sides[MESH_FACES] = { -PAD_AREA, PAD_AREA, -PAD_SIZE, PAD_SIZE, -1, 1 };
+
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			int row = y * CHUNK_SIZE + x;
+			for (int face = 0; face < MESH_FACES; face++)
+				face_rows[face * CHUNK_AREA + row] = 0;
+			model_rows[row] = 0;
+			for (int z = 0; z < CHUNK_SIZE; z++) {
+				int index = padIndex(x, y, z);
+				unsigned short int block = padded[index];
+				for (int face = 0; face < MESH_FACES; face++)
+					if (shows(block, padded[index + sides[face]]))
+						face_rows[face * CHUNK_AREA + row] |= (FaceRow)(1u << z);
+				int model = gamedata::blocks.getModelType(block);
+				if (gamedata::blocks.isRenderable(block) && (model == gamedata::MODEL_PLANT_2FACE || model == gamedata::MODEL_SURFACE_ONLY || model == gamedata::MODEL_PLANT_SURFACE_2FACE))
+					model_rows[row] |= (FaceRow)(1u << z);
+			}
+		}
+	}
+	if (!nearby_faces)
+		return;
+
+	*nearby_faces = 0;
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		for (int i = 0; i < CHUNK_SIZE; i++) {
+			if (shows(padded[padIndex(-1, y, i)], padded[padIndex(0, y, i)])) *nearby_faces |= Chunk::NEARBY_XN;
+			if (shows(padded[padIndex(CHUNK_SIZE, y, i)], padded[padIndex(CHUNK_SIZE - 1, y, i)])) *nearby_faces |= Chunk::NEARBY_XP;
+			if (shows(padded[padIndex(i, y, -1)], padded[padIndex(i, y, 0)])) *nearby_faces |= Chunk::NEARBY_ZN;
+			if (shows(padded[padIndex(i, y, CHUNK_SIZE)], padded[padIndex(i, y, CHUNK_SIZE - 1)])) *nearby_faces |= Chunk::NEARBY_ZP;
+		}
+	}
 }
 
-void remeshChunk(Chunk* chunk)
+// Remeshes the vertical sections whose bit is set in 'sections' (all of them for the first mesh) from the snapshots of the chunk and the nearby chunks.
+// 'nearby' is in Chunk::NEARBY_* order (XN, XP, ZN, ZP), nullptr where a nearby chunk is missing. The result is published by the caller.
+void remeshChunk(Chunk* chunk, unsigned int sections, const ChunkSnapshot* snapshot, const ChunkSnapshot* const nearby[4])
 {
 
-	int low_x, low_y, low_z, high_x, high_y, high_z;
-	unsigned short int tempb;
-	unsigned short int blt;
+	int high_x, high_z;
+	bool greedy = greedy_meshing;
+	bool bit_planes = bit_plane_culling;
+	bool first_mesh = false;
+	unsigned int uncovered[4] = { 0, 0, 0, 0 }; // Sections of the nearby chunks (in 'nearby' order) whose faces toward this chunk show up with it, see Chunk::nearbyChunkLoaded()
 
 	Chunk* chunk_on_xp = chunk->getChunkPointerOnXP();
 	Chunk* chunk_on_xn = chunk->getChunkPointerOnXN();
@@ -364,120 +1076,56 @@ void remeshChunk(Chunk* chunk)
 	if (!chunk_on_zp || chunk_on_zp->isFree() || !chunk_on_zp->isDataAvailable() || chunk_on_zp->isUnloadRequested()) chunk_on_zp = nullptr;
 	if (!chunk_on_zn || chunk_on_zn->isFree() || !chunk_on_zn->isDataAvailable() || chunk_on_zn->isUnloadRequested()) chunk_on_zn = nullptr;
 
-	int max_h = 0;
+	const ChunkSnapshot* nearby_xn = nearby[0];
+	const ChunkSnapshot* nearby_xp = nearby[1];
+	const ChunkSnapshot* nearby_zn = nearby[2];
+	const ChunkSnapshot* nearby_zp = nearby[3];
 
-	float light;
-	float s = 1.0f / 32.0f; // Texture atlas thingy
-	float sa, sb;
+	int max_h = 0;
 
-	int*& cheight = chunk->_heights();
-	int*& clight_heights = chunk->_light_heights();
-	float**& cvertical = chunk->_verticalChunkData();
-	bool*& cvertical_flags = chunk->_verticalChunkModified();
+	ChunkVertex**& cvertical = chunk->_verticalChunkData();
 	int*& cvertical_size = chunk->_verticalChunkSize();
 
-	if (!cheight) {
-		cheight = new int[(CHUNK_SIZE + 2) * (CHUNK_SIZE + 2)];
-	}
-	if (!clight_heights) {
-		clight_heights = new int[(CHUNK_SIZE + 2) * (CHUNK_SIZE + 2)];
-	}
 	if (!cvertical) {
-		cvertical = new float* [CHUNK_HEIGHT / CHUNK_SIZE];
+		cvertical = MemoryPool::allocateArray<ChunkVertex*>(CHUNK_HEIGHT / CHUNK_SIZE);
 		for (int i = 0; i < CHUNK_HEIGHT / CHUNK_SIZE; i++)
 			cvertical[i] = nullptr;
-		// New chunk, neighbor chunks need update
-		if (chunk_on_xp) chunk_on_xp->setUpdateNeededInAll();
-		if (chunk_on_xn) chunk_on_xn->setUpdateNeededInAll();
-		if (chunk_on_zp) chunk_on_zp->setUpdateNeededInAll();
-		if (chunk_on_zn) chunk_on_zn->setUpdateNeededInAll();
-	}
-	if (!cvertical_flags) {
-		cvertical_flags = new bool[CHUNK_HEIGHT / CHUNK_SIZE];
-		for (int i = 0; i < CHUNK_HEIGHT / CHUNK_SIZE; i++)
-			cvertical_flags[i] = true; // If cvertical_flags was null, we definitly need to remesh entire chunk
+		sections = ~0u; // New chunk, we definitly need to remesh entire chunk
+		first_mesh = true;
 	}
 	if (!cvertical_size) {
-		cvertical_size = new int[CHUNK_HEIGHT / CHUNK_SIZE];
+		cvertical_size = MemoryPool::allocateArray<int>(CHUNK_HEIGHT / CHUNK_SIZE);
 		for (int i = 0; i < CHUNK_HEIGHT / CHUNK_SIZE; i++)
 			cvertical_size[i] = 0;
 	}
 	
-	for (int x = 0; x < CHUNK_SIZE + 2; x++) {
-		for (int z = 0; z < CHUNK_SIZE + 2; z++) {
-			bool render_height_set = false;
-			for (short int y = CHUNK_HEIGHT - 1; y >= 0; y--) {
-				if (x == 0 && z > 0 && z <= CHUNK_SIZE && chunk_on_xn) {
-					if (chunk_on_xn->getLocalBlock(CHUNK_SIZE - 1, y, z - 1, tempb) && gamedata::blocks.indexer[tempb]->isRenderable()) {
-						if (!render_height_set) {
-							render_height_set = true;
-							cheight[x * (CHUNK_SIZE + 2) + z] = y;
-							if (max_h < y) max_h = y;
-						}
-						if (!gamedata::blocks.indexer[tempb]->hasTransparency()) {
-							render_height_set = true;
-							clight_heights[x * (CHUNK_SIZE + 2) + z] = y;
-							break;
-						}
-					}
-				}
-				else if (x == CHUNK_SIZE + 1 && z > 0 && z <= CHUNK_SIZE && chunk_on_xp) {
-					if (chunk_on_xp->getLocalBlock(0, y, z - 1, tempb) && gamedata::blocks.indexer[tempb]->isRenderable()) {
-						if (!render_height_set) {
-							render_height_set = true;
-							cheight[x * (CHUNK_SIZE + 2) + z] = y;
-							if (max_h < y) max_h = y;
-						}
-						if (!gamedata::blocks.indexer[tempb]->hasTransparency()) {
-							render_height_set = true;
-							clight_heights[x * (CHUNK_SIZE + 2) + z] = y;
-							break;
-						}
-					}
-				}
-				else if (z == 0 && x > 0 && x <= CHUNK_SIZE && chunk_on_zn) {
-					if (chunk_on_zn->getLocalBlock(x - 1, y, CHUNK_SIZE - 1, tempb) && gamedata::blocks.indexer[tempb]->isRenderable()) {
-						if (!render_height_set) {
-							render_height_set = true;
-							cheight[x * (CHUNK_SIZE + 2) + z] = y;
-							if (max_h < y) max_h = y;
-						}
-						if (!gamedata::blocks.indexer[tempb]->hasTransparency()) {
-							render_height_set = true;
-							clight_heights[x * (CHUNK_SIZE + 2) + z] = y;
-							break;
-						}
-					}
-				}
-				else if (z == CHUNK_SIZE + 1 && x > 0 && x <= CHUNK_SIZE && chunk_on_zp) { 
-					if (chunk_on_zp->getLocalBlock(x - 1, y, 0, tempb) && gamedata::blocks.indexer[tempb]->isRenderable()) {
-						if (!render_height_set) {
-							render_height_set = true;
-							cheight[x * (CHUNK_SIZE + 2) + z] = y;
-							if (max_h < y) max_h = y;
-						}
-						if (!gamedata::blocks.indexer[tempb]->hasTransparency()) {
-							render_height_set = true;
-							clight_heights[x * (CHUNK_SIZE + 2) + z] = y;
-							break;
-						}
-					}
-				}
-				else if (z > 0 && z <= CHUNK_SIZE && x > 0 && x <= CHUNK_SIZE) {
-					if (chunk->getLocalBlock(x - 1, y, z - 1, tempb) && gamedata::blocks.indexer[tempb]->isRenderable()) {
-						if (!render_height_set) {
-							render_height_set = true;
-							cheight[x * (CHUNK_SIZE + 2) + z] = y;
-							if (max_h < y) max_h = y;
-						}
-						if (!gamedata::blocks.indexer[tempb]->hasTransparency()) {
-							render_height_set = true;
-							clight_heights[x * (CHUNK_SIZE + 2) + z] = y;
-							break;
-						}
-					}
-				}
-			}
+	// Column tops of the chunk and the facing edges of the nearby chunks (18x18, corners are not used)
+	int clight_heights[(CHUNK_SIZE + 2) * (CHUNK_SIZE + 2)];
+	for (int i = 0; i < (CHUNK_SIZE + 2) * (CHUNK_SIZE + 2); i++)
+		clight_heights[i] = -1;
+
+	for (int x = 1; x <= CHUNK_SIZE; x++) {
+		for (int z = 1; z <= CHUNK_SIZE; z++) {
+			clight_heights[x * (CHUNK_SIZE + 2) + z] = snapshot->getColumnLightHeight(x - 1, z - 1);
+			if (max_h < snapshot->getColumnHeight(x - 1, z - 1)) max_h = snapshot->getColumnHeight(x - 1, z - 1);
+		}
+	}
+	for (int i = 1; i <= CHUNK_SIZE; i++) {
+		if (nearby_xn) {
+			clight_heights[i] = nearby_xn->getColumnLightHeight(CHUNK_SIZE - 1, i - 1);
+			if (max_h < nearby_xn->getColumnHeight(CHUNK_SIZE - 1, i - 1)) max_h = nearby_xn->getColumnHeight(CHUNK_SIZE - 1, i - 1);
+		}
+		if (nearby_xp) {
+			clight_heights[(CHUNK_SIZE + 1) * (CHUNK_SIZE + 2) + i] = nearby_xp->getColumnLightHeight(0, i - 1);
+			if (max_h < nearby_xp->getColumnHeight(0, i - 1)) max_h = nearby_xp->getColumnHeight(0, i - 1);
+		}
+		if (nearby_zn) {
+			clight_heights[i * (CHUNK_SIZE + 2)] = nearby_zn->getColumnLightHeight(i - 1, CHUNK_SIZE - 1);
+			if (max_h < nearby_zn->getColumnHeight(i - 1, CHUNK_SIZE - 1)) max_h = nearby_zn->getColumnHeight(i - 1, CHUNK_SIZE - 1);
+		}
+		if (nearby_zp) {
+			clight_heights[i * (CHUNK_SIZE + 2) + CHUNK_SIZE + 1] = nearby_zp->getColumnLightHeight(i - 1, 0);
+			if (max_h < nearby_zp->getColumnHeight(i - 1, 0)) max_h = nearby_zp->getColumnHeight(i - 1, 0);
 		}
 	}
 
@@ -486,12 +1134,22 @@ void remeshChunk(Chunk* chunk)
 	chunk->maxHeight() = max_h;
 
 	for (int y_step = 0; y_step < CHUNK_HEIGHT / CHUNK_SIZE; y_step++) {
-		if (!cvertical_flags[y_step]) // The vertical section is not updated, so we can skip that
+		if (!(sections & (1u << y_step))) // The vertical section is not updated, so we can skip that
 			continue;
 
-		if (max_h < y_step * CHUNK_SIZE) { // The chunk vertical section is updated, but there are no blocks in this section
+		unsigned short int uniform_block;
+		bool empty_section = snapshot->isSectionUniform(y_step, uniform_block) && !gamedata::blocks.isRenderable(uniform_block);
+
+		if (max_h < y_step * CHUNK_SIZE || empty_section) { // The chunk vertical section is updated, but there are no blocks in this section
+			if (first_mesh && max_h >= y_step * CHUNK_SIZE) { // Nothing covers the faces of the nearby chunks here, unless they are empty too
+				for (int n = 0; n < 4; n++) {
+					unsigned short int nearby_block;
+					if (nearby[n] && !(nearby[n]->isSectionUniform(y_step, nearby_block) && !gamedata::blocks.isRenderable(nearby_block)))
+						uncovered[n] |= 1u << y_step;
+				}
+			}
 			if (cvertical[y_step]) {
-				delete[] cvertical[y_step];
+				MemoryPool::release(cvertical[y_step]);
 				cvertical[y_step] = nullptr;
 			}
 			cvertical_size[y_step] = 0;
@@ -500,170 +1158,130 @@ void remeshChunk(Chunk* chunk)
 
 		bool delete_needed = cvertical[y_step] ? true : false; // If the data exists, we need to replace it.
 
-		float* tempbuffer = new float[147456]; // Maximum Possible Mesh Triangles in a chunk piece (Extremely rare)
+		ChunkVertex* tempbuffer = mesh_buffer; // Maximum Possible Mesh Triangles in a chunk piece (Extremely rare)
 
-		float* templiquidbuffer = new float[36864]; // Liquids should render after other things
+		ChunkVertex* templiquidbuffer = mesh_liquid_buffer; // Liquids should render after other things
 
 		int curr_size = 0;
 
 		int curr_liquid_size = 0;
 
-		int loop_limit = (y_step + 1) * CHUNK_SIZE; // Prevent recalculating
-
-		for (int y = y_step * CHUNK_SIZE; y < loop_limit; y++) {
-			low_y = y - 1;
-			high_y = y + 1;
+		gatherSection(snapshot, nearby, y_step, padded_blocks);
+
+		FaceRow face_rows[MESH_FACES * CHUNK_AREA];
+		FaceRow model_rows[CHUNK_AREA];
+		unsigned int nearby_faces = 0;
+		if (bit_planes)
+			cullFaces(padded_blocks, face_rows, model_rows, first_mesh ? &nearby_faces : nullptr);
+		else
+			cullFacesPerBlock(padded_blocks, face_rows, model_rows, first_mesh ? &nearby_faces : nullptr);
+		meshed_sections++;
+		for (int n = 0; n < 4; n++)
+			if (nearby_faces & (1u << n))
+				uncovered[n] |= 1u << y_step;
+
+		bool buffer_full = false;
+		for (int ly = 0; ly < CHUNK_SIZE; ly++) {
+			int y = y_step * CHUNK_SIZE + ly;
 			for (int x = 0; x < CHUNK_SIZE; x++) {
-				low_x = x - 1;
 				high_x = x + 1;
-				for (int z = 0; z < CHUNK_SIZE; z++) {
-					low_z = z - 1;
-					high_z = z + 1;
-
-					if (curr_size >= 147360 || curr_liquid_size >= 36780) // Almost impossible, just in case
-						break;
-
-					unsigned short int block;
-					if (!chunk->getLocalBlock(x, y, z, block))
-						return;
-					if (!gamedata::blocks.indexer[block]->isRenderable()) continue;
-
-					if (gamedata::blocks.indexer[block]->getModelType() == gamedata::MODEL_SOLID) {
-						chunk->getLocalBlock(x, low_y, z, tempb);
-						if (gamedata::blocks.indexer[tempb]->hasTransparency()) { // Down
-							createBottomFace(&tempbuffer[curr_size], x, y, z, 0, s, block);
-							curr_size += 36;
-						}
-
-						chunk->getLocalBlock(x, high_y, z, tempb);
-						if (gamedata::blocks.indexer[tempb]->hasTransparency()) { // Up 
-							createTopFace(&tempbuffer[curr_size], x, y, z, clight_heights[high_x * (CHUNK_SIZE + 2) + high_z], s, block);
-							curr_size += 36;
-						}
-
-						tempb = gamedata::blocks.stone.getID();
-						if (!chunk->getLocalBlock(low_x, y, z, tempb) && chunk_on_xn)
-							chunk_on_xn->getLocalBlock(CHUNK_SIZE - 1, y, z, tempb);
-						if (gamedata::blocks.indexer[tempb]->hasTransparency()) { // X-
-							createNegativeXFace(&tempbuffer[curr_size], x, y, z, clight_heights[x * (CHUNK_SIZE + 2) + high_z], s, block);
-							curr_size += 36;
-						}
-
-						tempb = gamedata::blocks.stone.getID();
-						if (!chunk->getLocalBlock(high_x, y, z, tempb) && chunk_on_xp)
-							chunk_on_xp->getLocalBlock(0, y, z, tempb);
-						if (gamedata::blocks.indexer[tempb]->hasTransparency()) { // X+
-							createPositiveXFace(&tempbuffer[curr_size], x, y, z, clight_heights[(high_x + 1) * (CHUNK_SIZE + 2) + high_z], s, block);
-							curr_size += 36;
-						}
+				int row = ly * CHUNK_SIZE + x;
+				if (buffer_full) { // Almost impossible, just in case (the rest of the section is left out)
+					for (int face = 0; face < MESH_FACES; face++)
+						face_rows[face * CHUNK_AREA + row] = 0;
+					continue;
+				}
 
-						tempb = gamedata::blocks.stone.getID();
-						if (!chunk->getLocalBlock(x, y, low_z, tempb) && chunk_on_zn)
-							chunk_on_zn->getLocalBlock(x, y, CHUNK_SIZE - 1, tempb);
-						if (gamedata::blocks.indexer[tempb]->hasTransparency()) { // Z-
-							createNegativeZFace(&tempbuffer[curr_size], x, y, z, clight_heights[high_x * (CHUNK_SIZE + 2) + z], s, block);
-							curr_size += 36;
-						}
+				unsigned int kept = ~0u; // Blocks of the row up to the one which filled the buffer
+				for (unsigned int bits = model_rows[row]; bits; bits &= bits - 1) {
+					int z = lowestBit(bits);
+					high_z = z + 1;
+					unsigned short int block = padded_blocks[padIndex(x, ly, z)];
+					bool lit = y >= clight_heights[high_x * (CHUNK_SIZE + 2) + high_z];
 
-						tempb = gamedata::blocks.stone.getID();
-						if (!chunk->getLocalBlock(x, y, high_z, tempb) && chunk_on_zp)
-							chunk_on_zp->getLocalBlock(x, y, 0, tempb);
-						if (gamedata::blocks.indexer[tempb]->hasTransparency()) { // Z+
-							createPositiveZFace(&tempbuffer[curr_size], x, y, z, clight_heights[high_x * (CHUNK_SIZE + 2) + high_z + 1], s, block);
-							curr_size += 36;
-						}
+					if (gamedata::blocks.getModelType(block) == gamedata::MODEL_PLANT_2FACE) {
+						createDiagonalFaces(&tempbuffer[curr_size], x, y, z, lit, block);
+						curr_size += 8;
 					}
 
-					if (gamedata::blocks.indexer[block]->getModelType() == gamedata::MODEL_PLANT_2FACE) {
-						createDiagonalFaces(&tempbuffer[curr_size], x, y, z, clight_heights[high_x * (CHUNK_SIZE + 2) + high_z], s, block);
-						curr_size += 72;
+					if (gamedata::blocks.getModelType(block) == gamedata::MODEL_SURFACE_ONLY) {
+						createTopFace(&tempbuffer[curr_size], x, y, z, lit, block, VERTEX_TOP_SURFACE);
+						curr_size += 4;
 					}
 
-					if (gamedata::blocks.indexer[block]->getModelType() == gamedata::MODEL_SURFACE_ONLY) {
-						createTopFace(&tempbuffer[curr_size], x, y, z, clight_heights[high_x * (CHUNK_SIZE + 2) + high_z], s, block, 0.05f);
-						curr_size += 36;
+					if (gamedata::blocks.getModelType(block) == gamedata::MODEL_PLANT_SURFACE_2FACE) {
+						createDiagonalFaces(&tempbuffer[curr_size], x, y, z, lit, block);
+						curr_size += 8;
+						createTopFace(&tempbuffer[curr_size], x, y, z, lit, block, VERTEX_TOP_SURFACE);
+						curr_size += 4;
 					}
 
-					if (gamedata::blocks.indexer[block]->getModelType() == gamedata::MODEL_PLANT_SURFACE_2FACE) {
-						createDiagonalFaces(&tempbuffer[curr_size], x, y, z, clight_heights[high_x * (CHUNK_SIZE + 2) + high_z], s, block);
-						curr_size += 72;
-						createTopFace(&tempbuffer[curr_size], x, y, z, clight_heights[high_x * (CHUNK_SIZE + 2) + high_z], s, block, 0.05f);
-						curr_size += 36;
+					if (curr_size > MESH_BUFFER_SIZE - 12) {
+						kept = (2u << z) - 1;
+						buffer_full = true;
+						break;
 					}
-					
-					if (gamedata::blocks.indexer[block]->getModelType() == gamedata::MODEL_LIQUID) {
-						chunk->getLocalBlock(x, low_y, z, tempb);
-						if (!gamedata::blocks.indexer[tempb]->isRenderable()) { // Down
-							createBottomFace(&templiquidbuffer[curr_liquid_size], x, y, z, 0, s, block);
-							curr_liquid_size += 36;
-						}
-
-						chunk->getLocalBlock(x, high_y, z, tempb);
-						if (!gamedata::blocks.indexer[tempb]->isRenderable()) { // Up 
-							createTopFace(&templiquidbuffer[curr_liquid_size], x, y, z, clight_heights[high_x * (CHUNK_SIZE + 2) + high_z], s, block, 0.9f);
-							curr_liquid_size += 36;
-						}
-
-						tempb = gamedata::blocks.stone.getID();
-						if (!chunk->getLocalBlock(low_x, y, z, tempb) && chunk_on_xn)
-							chunk_on_xn->getLocalBlock(CHUNK_SIZE - 1, y, z, tempb);
-						if (!gamedata::blocks.indexer[tempb]->isRenderable()) { // X-
-							createNegativeXFace(&templiquidbuffer[curr_liquid_size], x, y, z, clight_heights[x * (CHUNK_SIZE + 2) + high_z], s, block, 0.9f);
-							curr_liquid_size += 36;
-						}
-
-						tempb = gamedata::blocks.stone.getID();
-						if (!chunk->getLocalBlock(high_x, y, z, tempb) && chunk_on_xp)
-							chunk_on_xp->getLocalBlock(0, y, z, tempb);
-						if (!gamedata::blocks.indexer[tempb]->isRenderable()) { // X+
-							createPositiveXFace(&templiquidbuffer[curr_liquid_size], x, y, z, clight_heights[(high_x + 1) * (CHUNK_SIZE + 2) + high_z], s, block, 0.9f);
-							curr_liquid_size += 36;
-						}
-
-						tempb = gamedata::blocks.stone.getID();
-						if (!chunk->getLocalBlock(x, y, low_z, tempb) && chunk_on_zn)
-							chunk_on_zn->getLocalBlock(x, y, CHUNK_SIZE - 1, tempb);
-						if (!gamedata::blocks.indexer[tempb]->isRenderable()) { // Z-
-							createNegativeZFace(&templiquidbuffer[curr_liquid_size], x, y, z, clight_heights[high_x * (CHUNK_SIZE + 2) + z], s, block, 0.9f);
-							curr_liquid_size += 36;
-						}
+				}
 
-						tempb = gamedata::blocks.stone.getID();
-						if (!chunk->getLocalBlock(x, y, high_z, tempb) && chunk_on_zp)
-							chunk_on_zp->getLocalBlock(x, y, 0, tempb);
-						if (!gamedata::blocks.indexer[tempb]->isRenderable()) { // Z+
-							createPositiveZFace(&templiquidbuffer[curr_liquid_size], x, y, z, clight_heights[high_x * (CHUNK_SIZE + 2) + high_z + 1], s, block, 0.9f);
-							curr_liquid_size += 36;
+				for (int face = 0; face < MESH_FACES; face++) {
+					FaceRow& faces = face_rows[face * CHUNK_AREA + row];
+					faces &= kept;
+					for (unsigned int bits = faces; bits; bits &= bits - 1) {
+						int z = lowestBit(bits);
+						high_z = z + 1;
+						unsigned short int block = padded_blocks[padIndex(x, ly, z)];
+						bool lit;
+						switch (face) {
+						case FACE_BOTTOM: lit = false; break;
+						case FACE_TOP: lit = y >= clight_heights[high_x * (CHUNK_SIZE + 2) + high_z]; break;
+						case FACE_XN: lit = y >= clight_heights[x * (CHUNK_SIZE + 2) + high_z]; break;
+						case FACE_XP: lit = y >= clight_heights[(high_x + 1) * (CHUNK_SIZE + 2) + high_z]; break;
+						case FACE_ZN: lit = y >= clight_heights[high_x * (CHUNK_SIZE + 2) + z]; break;
+						default: lit = y >= clight_heights[high_x * (CHUNK_SIZE + 2) + high_z + 1]; break;
 						}
+						markFace(face, x, y, z, block, lit);
 					}
-
 				}
 			}
 		}
 
+		writeFaces(y_step, greedy, face_rows, tempbuffer, curr_size, templiquidbuffer, curr_liquid_size);
+
 		// Update chunk data
 		int total_size = curr_liquid_size + curr_size;
 
-		if (delete_needed) delete[] cvertical[y_step];
-		cvertical[y_step] = new float[total_size];
+		if (delete_needed) MemoryPool::release(cvertical[y_step]);
+		cvertical[y_step] = total_size ? MemoryPool::allocateArray<ChunkVertex>(total_size) : nullptr;
 		//std::cout << "Allocating CVERTICAL \"#" << y_step << "\" array for " << chunk->getChunkX() << ", " << chunk->getChunkZ() << std::endl;
 		cvertical_size[y_step] = total_size;
-		memcpy(&cvertical[y_step][0], tempbuffer, curr_size * sizeof(float));
-		memcpy(&cvertical[y_step][curr_size], templiquidbuffer, curr_liquid_size * sizeof(float));
-		cvertical_flags[y_step] = false;
-		delete[] tempbuffer;
-		delete[] templiquidbuffer;
+		if (total_size) {
+			memcpy(&cvertical[y_step][0], tempbuffer, curr_size * sizeof(ChunkVertex));
+			memcpy(&cvertical[y_step][curr_size], templiquidbuffer, curr_liquid_size * sizeof(ChunkVertex));
+		}
 	}
 
-	chunk->meshRequestResponse();
+	if (first_mesh) {
+		// New chunk, the nearby chunks meshed without it counted this side as solid. Only their faces toward it change (this chunk is on their opposite side)
+		if (!edge_only_invalidation)
+			for (int n = 0; n < 4; n++)
+				uncovered[n] = ~0u;
+		if (chunk_on_xn) chunk_on_xn->nearbyChunkLoaded(Chunk::NEARBY_XP, nearby_xn ? uncovered[0] : ~0u);
+		if (chunk_on_xp) chunk_on_xp->nearbyChunkLoaded(Chunk::NEARBY_XN, nearby_xp ? uncovered[1] : ~0u);
+		if (chunk_on_zn) chunk_on_zn->nearbyChunkLoaded(Chunk::NEARBY_ZP, nearby_zn ? uncovered[2] : ~0u);
+		if (chunk_on_zp) chunk_on_zp->nearbyChunkLoaded(Chunk::NEARBY_ZN, nearby_zp ? uncovered[3] : ~0u);
+	}
 }
 
 void saveAndFreeChunk(Chunk* chunk)
 {
 	ChunkDataFile cdf = ChunkDataFile(path);
 	if (/*chunk->isDataModified() && */chunk->isDataAvailable()) {
-		cdf.saveChunkData(chunk->getDataPointer(), chunk->getChunkX(), chunk->getChunkZ(), CHUNK_SIZE, CHUNK_HEIGHT);
+		chunk->copyData(chunk_data_buffer);
+		cdf.saveChunkData(chunk_data_buffer, chunk->getChunkX(), chunk->getChunkZ(), ChunkShape<CHUNK_SIZE, CHUNK_HEIGHT>());
 		cdf.saveChunkTData(chunk->getTickableBlocksPointer()->data(), chunk->getTickableBlocksPointer()->size(), chunk->getChunkX(), chunk->getChunkZ());
 	}
+	// Mesh jobs of nearby chunks may still be reading the data
+	while (chunk->isPinned())
+		std::this_thread::yield();
 	chunk->wipe();
 }
@@ -3,30 +3,56 @@
 #include <thread>
 #include <string>
 #include "Chunk.h"
-#include "Queue.h"
+#include "LatencyHistogram.h"
 
 /*
-This is the thread for processing load/generate/remesh/save/delete request for chunks.
+Stages of the chunk workers, each stage has its own workers and job queues:
+IO reads the chunk files and saves chunks, BUILD decodes the read files (or generates the chunks which were never saved), MESH builds the meshes.
+A load goes through IO and then BUILD, so a slow disk only holds up loads and saves, never meshing.
+*/
+enum ChunkStage { STAGE_IO, STAGE_BUILD, STAGE_MESH, CHUNK_STAGES };
+
+// See chunk_thread::benchmarkMeshing()
+struct MeshBenchmarkResult
+{
+	int chunks; // Meshed in each pass
+	int passes;
+	size_t vertices; // Of all the meshed chunks, one pass
+	unsigned long long vertex_hash; // FNV-1a of the vertices of all the meshed chunks in order, for comparing meshing paths
+	double microseconds_per_chunk;
+};
+
+/*
+This is a worker thread for processing load/generate/remesh/save/delete request for chunks. Run one per stage and worker index (0 to workers of the stage - 1).
 More info:
-This thread uses three queues (load/generate, save/delete, remesh) for each operations.
+Each worker has a lock-free job queue, new jobs are spread over the queues of their stage and idle workers steal jobs from the others of the same stage.
+Urgent jobs go to a shared queue which every worker checks first. Workers with nothing to do sleep until a job is enqueued.
+Load and mesh jobs can be cancelled or merged until a worker starts them (see JobTicket), the worker drops the stale ones.
 Once a Chunk is enqueued the process will automaticaly execute, for each task a flag will be 'true' until the job is finished.
 The flag means that the Chunk is still in queue and you may not do other operations at the same time.
+A mesh job pins the nearby chunks it reads, a save job waits for the pins before freeing the chunk.
+It meshes from snapshots of the chunks (see ChunkSnapshot), so block edits go on meanwhile. Sections edited while it ran are meshed again before the mesh is published.
 See Also:
 chunk_thread::initManagerThread, chunk_thread::enqueueLoadRequest, chunk_thread::enqueueSaveRequest, chunk_thread::enqueueMeshRequest, chunk_thread::saveAndKill
 */
-int chunkManagerThread();
+int chunkManagerThread(int stage, int worker);
 
 namespace chunk_thread
 {
-	/* Before running the thread, you may initialize the world name and the world save directory address using this function.
-	The information is used when saveing/loading the chunk data.*/
-	void initManagerThread(const char* world_name, const char* save_addr, int seeds[16]);
+	/* Before running the workers, you may initialize the world name and the world save directory address using this function.
+	The information is used when saveing/loading the chunk data. 'workers' is the number of chunkManagerThread() threads which will be started for each ChunkStage.
+	Each worker's job queue holds 'queue_capacity' jobs, give at least the number of jobs which can be pending at once (three per chunk).*/
+	void initManagerThread(const char* world_name, const char* save_addr, int seeds[16], const int workers[CHUNK_STAGES], int queue_capacity = 1024);
 	
 	/* You can enqueue a Chunk which you want to load or generate the data.
 	After a call the 'load_requested' flag on Chunk will be set until the data is in place.
 	While the flag is set, not request more requests and do not change variables on the Chunk object.*/
 	void enqueueLoadRequest(Chunk* chunk);
 
+	/* Cancels the chunk's load request if no worker started building it yet (its files may already be read), the 'load_requested' flag is cleared and the chunk can be wiped or requested again right away.
+	Returns false if the load is already being built (or done), then wait for it as usual.*/
+	bool cancelLoadRequest(Chunk* chunk);
+
 	/* You can enqueue a Chunk which you want to save and delete the data.
 	After a call the 'unload_requested' flag on Chunk will be set until the chunk is wiped as a new one.
 	While the flag is set, it means the chunk is about to get deleted, Don't touch it and let it go :)*/
@@ -35,13 +61,49 @@ namespace chunk_thread
 	/* You can enqueue a Chunk which you want to update the chunk mesh.
 	After a call the 'mesh_update_requested' flag on Chunk will be set. THE FLAG WILL REMAIN SET UNTIL YOU UPDATE VRAM DATA USING updateVRAM().
 	When the mesh buffer is generated, new_mesh_ready flag will be set and you should send the buffer to the GPU in the thread which you are using for OpenGL.
-	While the flag is set, not request more requests and do not change variables on the Chunk object.*/
-	void enqueueMeshRequest(Chunk* chunk);
+	Set 'urgent' for remeshes which the player waits for (block edits), they are taken before any other job.
+	Calling it again while the flag is set merges the request into the queued job, which remeshes every section marked by the time it starts (an urgent request also moves it to the urgent lane).
+	Returns false if the earlier job was already started. The marked sections stay marked, request again once its mesh is sent to VRAM.
+	While the flag is set, do not change other variables on the Chunk object.*/
+	bool enqueueMeshRequest(Chunk* chunk, bool urgent = false);
 
 	/* Cancels any pending request, saves any unsaved data from the list. AUTOMATICALY CALLED ON destroy() METHOD ON CHUNK MANAGER*/
 	void saveAndKill(Chunk* chunklist, int len);
 
-	/* Checks if the thread is ready for requests. */
+	/* Checks if all workers are ready for requests. */
 	bool isInitialized();
 
+	/* Jobs the workers dropped because they were cancelled or replaced before they started. */
+	unsigned long long getDroppedJobs();
+
+	/* Mesh requests merged into a job of the same chunk which was still queued. */
+	unsigned long long getMergedRequests();
+
+	/* Times a mesh job remeshed sections which were edited while it ran. */
+	unsigned long long getStaleMeshes();
+
+	/* Vertical sections the mesh jobs meshed, sections without blocks are not counted. */
+	unsigned long long getMeshedSections();
+
+	/* Turns merging the faces of same blocks into larger quads on or off (on by default, CHUNK_GREEDY_MESHING). Meshes made from then on use it, the rest stay as they are until remeshed. */
+	void setGreedyMeshing(bool enabled);
+
+	/* Turns finding the visible faces with bit operations on whole rows of blocks on or off (on by default). Off tests every block and side one by one, with the same result.
+	For tests and benchmarks, see tests/GoldenMeshTest.cpp. */
+	void setBitPlaneCulling(bool enabled);
+
+	/* Turns limiting the remesh of the nearby chunks after a chunk's first mesh to the sections where it uncovers their faces on or off (on by default). Off remeshes all their sections.
+	For benchmarks, see bench/FlythroughBenchmark.cpp. */
+	void setEdgeOnlyInvalidation(bool enabled);
+
+	/* How long the jobs of a stage waited in its queues before a worker started them. */
+	const LatencyHistogram* getStageWaitTimes(ChunkStage stage);
+
+	/* How long the jobs of a stage took to run. */
+	const LatencyHistogram* getStageRunTimes(ChunkStage stage);
+
+	/* Meshing benchmark without workers or OpenGL (see bench/MeshBenchmark.cpp). Generates the (2 * radius + 1)^2 chunks around chunk (0, 0) with the seeds given to initManagerThread(),
+	then meshes the chunks inside the outer ring 'passes' times on the calling thread, from snapshots like the mesh jobs. Call it after initManagerThread() while no worker is running.*/
+	MeshBenchmarkResult benchmarkMeshing(int radius, int passes);
+
 }
\ No newline at end of file
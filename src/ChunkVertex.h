@@ -0,0 +1,26 @@
+#pragma once
+
+/*
+A vertex of the chunk meshes packed in 8 bytes, unpacked by vshaderchunk.glsl (keep both in sync):
+position: x (5 bits), z (5 bits) and y (10 bits) in blocks inside the chunk, then the 2 bit offsets of x, z (VertexSideOffset) and y (VertexTopOffset).
+texture: atlas tile (10 bits), u and v in blocks inside the face (5 bits each, a merged face repeats its tile), light (8 bits, 255 is 1.0).
+Meshes are quads of 4 vertices drawn with a shared index buffer, see Chunk::bindQuadIndices().
+*/
+struct ChunkVertex
+{
+	unsigned int position;
+
+	unsigned int texture;
+
+	static ChunkVertex pack(int x, int y, int z, int tile, int u, int v, float light, int x_offset = 0, int z_offset = 0, int y_offset = 0) {
+		ChunkVertex vertex;
+		vertex.position = (unsigned int)x | (unsigned int)z << 5 | (unsigned int)y << 10 | (unsigned int)x_offset << 20 | (unsigned int)z_offset << 22 | (unsigned int)y_offset << 24;
+		vertex.texture = (unsigned int)tile | (unsigned int)u << 10 | (unsigned int)v << 15 | (unsigned int)(light * 255.0f + 0.5f) << 24;
+		return vertex;
+	}
+};
+
+// Parts of a block a vertex may be at besides its corners, the shader adds them to the whole block position
+enum VertexSideOffset { VERTEX_SIDE_WHOLE, VERTEX_SIDE_NEAR, VERTEX_SIDE_FAR }; // +0, +1/7, +6/7 (plant models)
+
+enum VertexTopOffset { VERTEX_TOP_WHOLE, VERTEX_TOP_LIQUID, VERTEX_TOP_SURFACE }; // +0, +0.9, +0.05
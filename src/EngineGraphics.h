@@ -1335,6 +1335,7 @@ private:
 	Shader* shader_3d;
 	Shader* shader_2d;
 	Shader* shader_3dbg;
+	Shader* shader_chunk;
 	Camera* currentCamera;
 	RawModel* default_gui;
 	RawModel* bg_render_assist;
@@ -1357,6 +1358,7 @@ public:
 		shader_2d = nullptr;
 		shader_3d = nullptr;
 		shader_3dbg = nullptr;
+		shader_chunk = nullptr;
 		width = 800;
 		height = 600;
 		sky_color = glm::vec3(0.5f, 0.6f, 0.8f);
@@ -1454,6 +1456,11 @@ public:
 		shader_3dbg = new Shader(vshaderpath, fshaderpath);
 	}
 
+	// For the packed chunk meshes (see ChunkVertex)
+	void initializeChunkShader(const char* vshaderpath, const char* fshaderpath) {
+		shader_chunk = new Shader(vshaderpath, fshaderpath);
+	}
+
 	void prepare() {
 		glClearColor(sky_color.x * sun_light, sky_color.y * sun_light, sky_color.z * sun_light, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -1481,6 +1488,17 @@ public:
 		shader_3d->loadUniform3f("fog_color", horizon_color);
 	}
 
+	// After prepare3D(), for renderChunk(). Call prepare3D() again before rendering entities.
+	void prepareChunks() {
+		active_shader = 31;
+		shader_chunk->enableShaderProgram();
+		shader_chunk->loadMatrix4f("view", currentCamera->getViewMatrix());
+		shader_chunk->loadMatrix4f("projection", currentCamera->getProjectionMatrix());
+		shader_chunk->loadUniform1f("light_factor", sun_light);
+		shader_chunk->loadUniform1f("fogDensity", 0.007f);
+		shader_chunk->loadUniform3f("fog_color", horizon_color);
+	}
+
 	void prepareBackground() {
 		active_shader = 30;
 		shader_3dbg->enableShaderProgram();
@@ -1579,18 +1597,17 @@ public:
 		entity.getModel()->unbindModel();
 	}
 	
+	// 'vbolen' is the vertices of the mesh, 4 per quad (see Chunk::bindQuadIndices())
 	void renderChunk(Texture* texture, glm::mat4 transform, unsigned int vbolen, unsigned int vao, bool first = false) {
 		if (first) {
 			glBindTexture(GL_TEXTURE_2D, texture->getID());
-			shader_3d->loadUniform2f("coordFactors", 1.0f, 1.0f);
-			shader_3d->loadUniform2f("coordOffsets", 0.0f, 0.0f);
 		}
 
-		shader_3d->loadMatrix4f("transform", transform);
+		shader_chunk->loadMatrix4f("transform", transform);
 
 		glBindVertexArray(vao);
 
-		glDrawArrays(GL_TRIANGLES, 0, vbolen);
+		glDrawElements(GL_TRIANGLES, vbolen / 4 * 6, GL_UNSIGNED_INT, (void*)0);
 
 		glBindVertexArray(0);
 	}
@@ -1627,6 +1644,12 @@ public:
 			shader_3dbg = nullptr;
 		}
 
+		if (shader_chunk) {
+			shader_chunk->deleteShaderProgram();
+			delete shader_chunk;
+			shader_chunk = nullptr;
+		}
+
 		if (active) {
 			glfwTerminate();
 			delete[] _key_status;
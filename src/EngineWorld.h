@@ -128,6 +128,14 @@ public:
 		return terrain_manager.getRenderInfoFor(vao, vbo_length, cx, cz);
 	}
 
+	void terrainMemoryReport(int& loaded_chunks, size_t& data_bytes) {
+		terrain_manager.getMemoryReport(loaded_chunks, data_bytes);
+	}
+
+	void terrainMeshReport(int& meshed_chunks, size_t& vertices) {
+		terrain_manager.getMeshReport(meshed_chunks, vertices);
+	}
+
 	ItemInventory& playerInventory() {
 		return player_inventory;
 	}
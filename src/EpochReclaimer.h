@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/*
+Frees memory which other threads may still be reading, once none of them can be anymore (epoch based reclamation).
+Readers (the chunk workers) enter() before each job and leave() after it, each in its own slot. retire() stamps a pointer with the global epoch and moves the epoch on,
+reclaim() frees everything retired before the oldest epoch a reader is still in. Nobody waits: a pointer retired during a long job is freed by a later reclaim().
+The pointer must be unreachable for new readers before it is retired. Any thread may retire and reclaim.
+*/
+class EpochReclaimer
+{
+public:
+
+	typedef void (*Deleter)(void*);
+
+	EpochReclaimer() {
+		slots = nullptr;
+		readers = 0;
+	}
+
+	~EpochReclaimer() {
+		reclaimAll();
+		delete[] slots;
+	}
+
+	EpochReclaimer(const EpochReclaimer&) = delete;
+
+	EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+	// Not thread safe, call before the readers start. Anything still retired is freed.
+	void initialize(int reader_count) {
+		reclaimAll();
+		delete[] slots;
+		readers = reader_count;
+		slots = new Slot[readers];
+	}
+
+	// Reader 'reader' may read retired pointers from now until leave(). Announces the current epoch, retried until it did not move meanwhile.
+	void enter(int reader) {
+		unsigned long long epoch = global_epoch.load();
+		for (;;) {
+			slots[reader].epoch.store(epoch);
+			unsigned long long now = global_epoch.load();
+			if (now == epoch)
+				return;
+			epoch = now;
+		}
+	}
+
+	void leave(int reader) {
+		slots[reader].epoch.store(IDLE);
+	}
+
+	// 'deleter' is called on 'ptr' once no reader which could have seen it is left.
+	void retire(void* ptr, Deleter deleter) {
+		std::lock_guard<std::mutex> lock(retired_mutex);
+		retired.push_back({ ptr, deleter, global_epoch.fetch_add(1) });
+		retired_count.store(retired.size(), std::memory_order_relaxed);
+	}
+
+	// Frees what no reader can see anymore. Cheap when nothing is retired.
+	void reclaim() {
+		if (retired_count.load(std::memory_order_relaxed) == 0)
+			return;
+		// Pointers retired from here on are stamped with this epoch or later, so they are never freed by this call
+		unsigned long long oldest = global_epoch.load();
+		for (int i = 0; i < readers; i++) {
+			unsigned long long epoch = slots[i].epoch.load();
+			if (epoch < oldest)
+				oldest = epoch;
+		}
+		std::lock_guard<std::mutex> lock(retired_mutex);
+		size_t kept = 0;
+		for (size_t i = 0; i < retired.size(); i++) {
+			if (retired[i].epoch < oldest)
+				retired[i].deleter(retired[i].ptr);
+			else
+				retired[kept++] = retired[i];
+		}
+		retired.resize(kept);
+		retired_count.store(kept, std::memory_order_relaxed);
+	}
+
+	// Frees everything retired. Only when no reader is left.
+	void reclaimAll() {
+		std::lock_guard<std::mutex> lock(retired_mutex);
+		for (size_t i = 0; i < retired.size(); i++)
+			retired[i].deleter(retired[i].ptr);
+		retired.clear();
+		retired_count.store(0, std::memory_order_relaxed);
+	}
+
+private:
+
+	static const unsigned long long IDLE = ~0ull;
+
+	static const int CACHE_LINE = 64;
+
+	// One per reader, on its own cache line
+	struct alignas(CACHE_LINE) Slot {
+		std::atomic<unsigned long long> epoch{ IDLE };
+	};
+
+	struct Retired {
+		void* ptr;
+		Deleter deleter;
+		unsigned long long epoch;
+	};
+
+	Slot* slots;
+
+	int readers;
+
+	std::atomic<unsigned long long> global_epoch{ 0 };
+
+	std::mutex retired_mutex;
+
+	std::vector<Retired> retired; // Guarded by retired_mutex
+
+	std::atomic<size_t> retired_count{ 0 };
+
+};
@@ -1536,56 +1536,93 @@ BlockData::BlockData()
 	jungle_sapling.setTransparency(true);
 	jungle_sapling.setModelType(gamedata::MODEL_PLANT_2FACE);
 	auto_add++;
+
+	block_count = auto_add;
+	buildPropertyTables();
+}
+
+void BlockData::buildPropertyTables()
+{
+	int words = (gamedata::INDEXER_LIMIT + 31) / 32;
+	renderable_bits = new unsigned int[words];
+	transparency_bits = new unsigned int[words];
+	opaque_bits = new unsigned int[words];
+	collision_bits = new unsigned int[words];
+	touchable_bits = new unsigned int[words];
+	tickable_bits = new unsigned int[words];
+	model_types = new unsigned char[gamedata::INDEXER_LIMIT];
+	face_textures = new unsigned int[gamedata::INDEXER_LIMIT * 6];
+
+	for (int i = 0; i < words; i++)
+		renderable_bits[i] = transparency_bits[i] = opaque_bits[i] = collision_bits[i] = touchable_bits[i] = tickable_bits[i] = 0;
+	for (int i = 0; i < gamedata::INDEXER_LIMIT; i++)
+		model_types[i] = 0;
+	for (int i = 0; i < gamedata::INDEXER_LIMIT * 6; i++)
+		face_textures[i] = 0;
+
+	for (int i = 0; i < block_count; i++) {
+		const Block* b = indexer[i];
+		unsigned int bit = 1u << (i & 31);
+		if (b->isRenderable()) renderable_bits[i >> 5] |= bit;
+		if (b->hasTransparency()) transparency_bits[i >> 5] |= bit;
+		if (b->isRenderable() && !b->hasTransparency()) opaque_bits[i >> 5] |= bit;
+		if (b->hasCollision()) collision_bits[i >> 5] |= bit;
+		if (b->isTouchable()) touchable_bits[i >> 5] |= bit;
+		if (isTickableBlock(i)) tickable_bits[i >> 5] |= bit;
+		model_types[i] = (unsigned char)b->getModelType();
+		for (int d = 0; d < 6; d++)
+			face_textures[i * 6 + d] = b->getBlockTexture(d);
+	}
 }
 
-bool BlockData::isTickable(unsigned short int i)
+bool BlockData::isTickableBlock(unsigned short int i) const
 {
 	// TODO: add 'tickable' field to 'Block', set default value to false, plus a getter and setter.
-	// then: return gamedata::blocks.indexer[i].isTickable();
+	// then: return indexer[i]->isTickable();
 	return
-		(i == gamedata::blocks.dirt.getID()) ||
-		(i == gamedata::blocks.grass.getID()) ||
-		(i == gamedata::blocks.strawberry_bush.getID()) ||
-		(i == gamedata::blocks.strawberry_bush_dead.getID()) ||
-		(i == gamedata::blocks.strawberry_bush_fruit.getID()) ||
-		(i == gamedata::blocks.dwarf_blueberry_bush.getID()) ||
-		(i == gamedata::blocks.dwarf_blueberry_bush_frozen.getID()) ||
-		(i == gamedata::blocks.dwarf_blueberry_bush_fruit.getID()) ||
-		(i == gamedata::blocks.bearberry_bush.getID()) ||
-		(i == gamedata::blocks.bearberry_bush_frozen.getID()) ||
-		(i == gamedata::blocks.bearberry_bush_fruit.getID()) ||
-		(i == gamedata::blocks.dwarf_birch_leaves.getID()) ||
-		(i == gamedata::blocks.dwarf_birch_leaves_frosty.getID()) ||
-		(i == gamedata::blocks.spruce_leaves.getID()) ||
-		(i == gamedata::blocks.spruce_leaves_frosty.getID()) ||
-		(i == gamedata::blocks.pine_leaves.getID()) ||
-		(i == gamedata::blocks.pine_leaves_frosty.getID()) ||
-		(i == gamedata::blocks.maple_leaves_green_o.getID()) ||
-		(i == gamedata::blocks.maple_leaves_green_r.getID()) ||
-		(i == gamedata::blocks.maple_leaves_green_y.getID()) ||
-		(i == gamedata::blocks.maple_leaves_orange.getID()) ||
-		(i == gamedata::blocks.maple_leaves_red.getID()) ||
-		(i == gamedata::blocks.maple_leaves_yellow.getID()) ||
-		(i == gamedata::blocks.maple_leaves_winter_o.getID()) ||
-		(i == gamedata::blocks.maple_leaves_winter_r.getID()) ||
-		(i == gamedata::blocks.maple_leaves_winter_y.getID()) ||
-		(i == gamedata::blocks.birch_leaves_green_o.getID()) ||
-		(i == gamedata::blocks.birch_leaves_green_r.getID()) ||
-		(i == gamedata::blocks.birch_leaves_green_y.getID()) ||
-		(i == gamedata::blocks.birch_leaves_orange.getID()) ||
-		(i == gamedata::blocks.birch_leaves_red.getID()) ||
-		(i == gamedata::blocks.birch_leaves_yellow.getID()) ||
-		(i == gamedata::blocks.birch_leaves_winter_o.getID()) ||
-		(i == gamedata::blocks.birch_leaves_winter_r.getID()) ||
-		(i == gamedata::blocks.birch_leaves_winter_y.getID()) ||
-		(i == gamedata::blocks.tallgrass.getID()) ||
-		(i == gamedata::blocks.tallgrass_dead.getID()) ||
-		(i == gamedata::blocks.tallgrass_short.getID()) ||
-		(i == gamedata::blocks.tallgrass_short_dead.getID()) ||
-		(i == gamedata::blocks.surface_moss.getID()) ||
-		(i == gamedata::blocks.surface_moss_frosty.getID()) ||
-		(i == gamedata::blocks.lichen.getID()) ||
-		(i == gamedata::blocks.lichen_frosty.getID())
+		(i == dirt.getID()) ||
+		(i == grass.getID()) ||
+		(i == strawberry_bush.getID()) ||
+		(i == strawberry_bush_dead.getID()) ||
+		(i == strawberry_bush_fruit.getID()) ||
+		(i == dwarf_blueberry_bush.getID()) ||
+		(i == dwarf_blueberry_bush_frozen.getID()) ||
+		(i == dwarf_blueberry_bush_fruit.getID()) ||
+		(i == bearberry_bush.getID()) ||
+		(i == bearberry_bush_frozen.getID()) ||
+		(i == bearberry_bush_fruit.getID()) ||
+		(i == dwarf_birch_leaves.getID()) ||
+		(i == dwarf_birch_leaves_frosty.getID()) ||
+		(i == spruce_leaves.getID()) ||
+		(i == spruce_leaves_frosty.getID()) ||
+		(i == pine_leaves.getID()) ||
+		(i == pine_leaves_frosty.getID()) ||
+		(i == maple_leaves_green_o.getID()) ||
+		(i == maple_leaves_green_r.getID()) ||
+		(i == maple_leaves_green_y.getID()) ||
+		(i == maple_leaves_orange.getID()) ||
+		(i == maple_leaves_red.getID()) ||
+		(i == maple_leaves_yellow.getID()) ||
+		(i == maple_leaves_winter_o.getID()) ||
+		(i == maple_leaves_winter_r.getID()) ||
+		(i == maple_leaves_winter_y.getID()) ||
+		(i == birch_leaves_green_o.getID()) ||
+		(i == birch_leaves_green_r.getID()) ||
+		(i == birch_leaves_green_y.getID()) ||
+		(i == birch_leaves_orange.getID()) ||
+		(i == birch_leaves_red.getID()) ||
+		(i == birch_leaves_yellow.getID()) ||
+		(i == birch_leaves_winter_o.getID()) ||
+		(i == birch_leaves_winter_r.getID()) ||
+		(i == birch_leaves_winter_y.getID()) ||
+		(i == tallgrass.getID()) ||
+		(i == tallgrass_dead.getID()) ||
+		(i == tallgrass_short.getID()) ||
+		(i == tallgrass_short_dead.getID()) ||
+		(i == surface_moss.getID()) ||
+		(i == surface_moss_frosty.getID()) ||
+		(i == lichen.getID()) ||
+		(i == lichen_frosty.getID())
 		;
 }
 
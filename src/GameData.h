@@ -275,7 +275,60 @@ struct ItemData {
 struct BlockData {
 	BlockData();
 
-	bool isTickable(unsigned short int i);
+	// Property lookups by block id from flat tables, for hot loops (meshing, physics, raycasting). Same values as the 'Block' getters.
+	// Unknown ids (past the last block, e.g. 65535 from a damaged chunk file) read the entries of air (id 0): not renderable, with transparency.
+	bool isRenderable(unsigned short int i) const {
+		if (i >= block_count)
+			i = 0; // Air
+		return (renderable_bits[i >> 5] >> (i & 31)) & 1;
+	}
+
+	bool hasTransparency(unsigned short int i) const {
+		if (i >= block_count)
+			i = 0; // Air
+		return (transparency_bits[i >> 5] >> (i & 31)) & 1;
+	}
+
+	// Renderable and without transparency
+	bool isOpaque(unsigned short int i) const {
+		if (i >= block_count)
+			i = 0; // Air
+		return (opaque_bits[i >> 5] >> (i & 31)) & 1;
+	}
+
+	bool hasCollision(unsigned short int i) const {
+		if (i >= block_count)
+			i = 0; // Air
+		return (collision_bits[i >> 5] >> (i & 31)) & 1;
+	}
+
+	bool isTouchable(unsigned short int i) const {
+		if (i >= block_count)
+			i = 0; // Air
+		return (touchable_bits[i >> 5] >> (i & 31)) & 1;
+	}
+
+	// Blocks with random ticks (growth, decay, seasons), see BlockTicks
+	bool isTickable(unsigned short int i) const {
+		if (i >= block_count)
+			i = 0; // Air
+		return (tickable_bits[i >> 5] >> (i & 31)) & 1;
+	}
+
+	// The comparisons of block ids which the tickable bits are built from, much slower than isTickable() (see bench/GenerationBenchmark.cpp)
+	bool isTickableBlock(unsigned short int i) const;
+
+	int getModelType(unsigned short int i) const {
+		if (i >= block_count)
+			i = 0; // Air
+		return model_types[i];
+	}
+
+	unsigned int getBlockTexture(unsigned short int i, int direction) const {
+		if (i >= block_count)
+			i = 0; // Air
+		return face_textures[i * 6 + direction];
+	}
 
 	Block air;
 	Block stone;
@@ -360,6 +413,25 @@ struct BlockData {
 	Block jungle_sapling;
 
 	Block** indexer;
+
+	int block_count;
+
+private:
+
+	// One bit per block id
+	unsigned int* renderable_bits;
+	unsigned int* transparency_bits;
+	unsigned int* opaque_bits;
+	unsigned int* collision_bits;
+	unsigned int* touchable_bits;
+	unsigned int* tickable_bits;
+
+	unsigned char* model_types;
+
+	// Six per block id, in DIRECTION_* order
+	unsigned int* face_textures;
+
+	void buildPropertyTables();
 };
 
 namespace gamedata {
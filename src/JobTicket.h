@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+
+/*
+Lets the main thread cancel or replace a queued chunk job until a worker starts it.
+The main thread issues a ticket for each job it queues, the job carries it. A worker runs the job only if it can redeem the ticket,
+cancel() redeems the last issued one on the main thread instead. Exactly one of them succeeds, a job whose ticket was redeemed elsewhere is dropped.
+Tickets are never reset (also not when the chunk slot is reused), so a dropped job never touches anything but the ticket.
+*/
+class JobTicket
+{
+public:
+
+	// Main thread only. The ticket for a new job.
+	unsigned int issue() {
+		issued = current.load();
+		return issued;
+	}
+
+	// Worker side. True if the job holding 'ticket' may run, false if it was cancelled or replaced.
+	bool redeem(unsigned int ticket) {
+		return current.compare_exchange_strong(ticket, ticket + 1);
+	}
+
+	// Worker side. True if the job holding 'ticket' was not cancelled or replaced yet, only a hint (it may be cancelled right after).
+	bool isCurrent(unsigned int ticket) const {
+		return current.load() == ticket;
+	}
+
+	// Main thread only. True if the last issued job was not started, it will never run now.
+	bool cancel() {
+		return redeem(issued);
+	}
+
+	// Main thread only. True while the last issued job is not started, only a hint since a worker may take it any time.
+	bool isQueued() const {
+		return current.load() == issued;
+	}
+
+private:
+
+	std::atomic<unsigned int> current{ 0 };
+
+	unsigned int issued = ~0u;
+
+};
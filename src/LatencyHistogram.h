@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+
+/*
+Counts durations in power of two microsecond buckets: bucket 0 is under 1 us, bucket n is [2^(n-1), 2^n) us.
+Any thread may add at any time, counters are relaxed atomics, so readers get a close (not exact) picture while it is being filled.
+*/
+class LatencyHistogram
+{
+public:
+
+	static const int BUCKETS = 32;
+
+	void add(long long microseconds) {
+		int bucket = 0;
+		while (bucket < BUCKETS - 1 && (1LL << bucket) <= microseconds)
+			bucket++;
+		counts[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	unsigned long long getCount() const {
+		unsigned long long total = 0;
+		for (int i = 0; i < BUCKETS; i++)
+			total += counts[i].load(std::memory_order_relaxed);
+		return total;
+	}
+
+	unsigned long long getBucketCount(int bucket) const {
+		return counts[bucket].load(std::memory_order_relaxed);
+	}
+
+	// Upper bound in microseconds of the bucket holding the 'percent' percentile (0 to 100), 0 if nothing was added.
+	long long getPercentile(float percent) const {
+		unsigned long long total = getCount();
+		if (total == 0)
+			return 0;
+		unsigned long long rank = (unsigned long long)(total * percent / 100.0f);
+		if (rank >= total)
+			rank = total - 1;
+		unsigned long long seen = 0;
+		for (int i = 0; i < BUCKETS; i++) {
+			seen += counts[i].load(std::memory_order_relaxed);
+			if (seen > rank)
+				return 1LL << i;
+		}
+		return 1LL << (BUCKETS - 1);
+	}
+
+	void clear() {
+		for (int i = 0; i < BUCKETS; i++)
+			counts[i].store(0, std::memory_order_relaxed);
+	}
+
+private:
+
+	std::atomic<unsigned long long> counts[BUCKETS] = {};
+
+};
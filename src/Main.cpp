@@ -41,7 +41,7 @@ bool game_running;
 
 unsigned short int func_getBlock(int x, int y, int z) { return current_world->getBlock(x, y, z); }
 
-bool func_isBlockLiquid(unsigned short int block) { return gamedata::blocks.indexer[block]->getID() == gamedata::blocks.water.getID(); }
+bool func_isBlockLiquid(unsigned short int block) { return block == gamedata::blocks.water.getID(); }
 
 void game_core();
 
@@ -55,11 +55,11 @@ int main()
 }
 
 bool func_blockHasHitbox(unsigned short int blockid) {
-	return gamedata::blocks.indexer[blockid]->hasCollision();
+	return gamedata::blocks.hasCollision(blockid);
 }
 
 bool func_blockIsTouchable(unsigned short int blockid) {
-	return gamedata::blocks.indexer[blockid]->isTouchable();
+	return gamedata::blocks.isTouchable(blockid);
 }
 
 void game_play(WorldRecord& world_record, SettingsRecord& settings_record, StatisticsRecord& statistics_record, int user_id, Camera& game_camera, Renderer& game_renderer, bool new_world) {
@@ -112,6 +112,7 @@ void game_play(WorldRecord& world_record, SettingsRecord& settings_record, Stati
 
 	// Player Setup
 	bool player_update = true;
+	float sent_yaw = 0.0f; // Last yaw given to the world, loads are ordered by view direction
 	int selected_index = 0;
 
 	PhysicalPlayer player;
@@ -195,6 +196,18 @@ void game_play(WorldRecord& world_record, SettingsRecord& settings_record, Stati
 	GUIText txt_fps_info = GUIText(&font_texture, temp_buffer, 2, 42, 8, -1, 1, 1);
 	gui_scene_debug_text.add(txt_fps_info);
 
+	sprintf(temp_buffer, "Chunks: %d, block data: %.1f MB", 0, 0.0f);
+	GUIText txt_memory_info = GUIText(&font_texture, temp_buffer, 2, 52, 8, -1, 1, 1);
+	gui_scene_debug_text.add(txt_memory_info);
+
+	sprintf(temp_buffer, "Chunk stages p95 (queued + run) ms:");
+	GUIText txt_stage_info = GUIText(&font_texture, temp_buffer, 2, 62, 8, -1, 1, 1);
+	gui_scene_debug_text.add(txt_stage_info);
+
+	sprintf(temp_buffer, "Meshes: %d, vertices: %.1fk", 0, 0.0f);
+	GUIText txt_mesh_info = GUIText(&font_texture, temp_buffer, 2, 72, 8, -1, 1, 1);
+	gui_scene_debug_text.add(txt_mesh_info);
+
 	GUIImage gui_cross = GUIImage(&crosshair_texture, 0, 0, 16, 16, 0, 0, 1, 0);
 	gui_scene_hud.add(gui_cross);
 
@@ -867,9 +880,12 @@ void game_play(WorldRecord& world_record, SettingsRecord& settings_record, Stati
 		}
 
 		// World Update
+		if (player_update || player.getYaw() != sent_yaw) { // Turning in place reorders the loads as well
+			sent_yaw = player.getYaw();
+			world.updateCurrentPosition(player.getGlobalX(), player.getGlobalY(), player.getGlobalZ(), player.getYaw());
+		}
 		if (player_update) {
 			player_update = false;
-			world.updateCurrentPosition(player.getGlobalX(), player.getGlobalY(), player.getGlobalZ());
 
 			sprintf(temp_buffer, "x:%d y:%d z:%d", player.getGlobalX(), player.getGlobalY(), player.getGlobalZ());
 			txt_position.setText(temp_buffer);
@@ -983,6 +999,32 @@ void game_play(WorldRecord& world_record, SettingsRecord& settings_record, Stati
 			sprintf(temp_buffer, "FPS: %.1f", (float)(30.0 / (glfwGetTime() - start)) );
 			txt_fps_info.setText(temp_buffer);
 			start = glfwGetTime();
+
+			int loaded_chunks;
+			size_t data_bytes;
+			world.terrainMemoryReport(loaded_chunks, data_bytes);
+			static unsigned long long last_heap_allocations = 0;
+			unsigned long long heap_allocations = MemoryPool::getHeapAllocations();
+			sprintf(temp_buffer, "Chunks: %d, block data: %.1f MB (%.1f KB/chunk), heap allocs: %llu (pooled: %llu)", loaded_chunks, data_bytes / 1048576.0f,
+				loaded_chunks ? data_bytes / 1024.0f / loaded_chunks : 0.0f, heap_allocations - last_heap_allocations, MemoryPool::getPoolAllocations());
+			last_heap_allocations = heap_allocations;
+			txt_memory_info.setText(temp_buffer);
+
+			float stage_times[CHUNK_STAGES * 2];
+			for (int stage = 0; stage < CHUNK_STAGES; stage++) {
+				stage_times[stage * 2] = chunk_thread::getStageWaitTimes((ChunkStage)stage)->getPercentile(95.0f) / 1000.0f;
+				stage_times[stage * 2 + 1] = chunk_thread::getStageRunTimes((ChunkStage)stage)->getPercentile(95.0f) / 1000.0f;
+			}
+			sprintf(temp_buffer, "Chunk stages p95 (queued + run) ms: io %.1f + %.1f, build %.1f + %.1f, mesh %.1f + %.1f",
+				stage_times[0], stage_times[1], stage_times[2], stage_times[3], stage_times[4], stage_times[5]);
+			txt_stage_info.setText(temp_buffer);
+
+			int meshed_chunks;
+			size_t vertices;
+			world.terrainMeshReport(meshed_chunks, vertices);
+			sprintf(temp_buffer, "Meshes: %d, vertices: %.1fk (%.0f/chunk), mesh run p50 %.2f ms", meshed_chunks, vertices / 1000.0f,
+				meshed_chunks ? (float)vertices / meshed_chunks : 0.0f, chunk_thread::getStageRunTimes(STAGE_MESH)->getPercentile(50.0f) / 1000.0f);
+			txt_mesh_info.setText(temp_buffer);
 		}
 
 		if (inventory_open) {
@@ -1060,6 +1102,7 @@ void game_play(WorldRecord& world_record, SettingsRecord& settings_record, Stati
 		int cx, cz, vbo_length, first = 1;
 		unsigned int vao;
 
+		game_renderer.prepareChunks();
 		glEnable(GL_BLEND);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		while (!world.renderNextChunkInfo(vao, vbo_length, cx, cz)) {
@@ -1067,6 +1110,7 @@ void game_play(WorldRecord& world_record, SettingsRecord& settings_record, Stati
 			first = 0;
 		}
 		glDisable(GL_BLEND);
+		game_renderer.prepare3D();
 
 		game_renderer.renderBasicEntity(entity_selected_block);
 		if (local_rain > 0.0f) game_renderer.renderBasicEntity(entity_rain);
@@ -1223,6 +1267,7 @@ void game_core()
 	game_renderer.initialize3DShader(ASSET_DIR_PATH"vshader3.glsl", ASSET_DIR_PATH"fshader3.glsl");
 	game_renderer.initialize2DShader(ASSET_DIR_PATH"vshader2.glsl", ASSET_DIR_PATH"fshader2.glsl");
 	game_renderer.initialize3DBackgroundShader(ASSET_DIR_PATH"vshaderbg.glsl", ASSET_DIR_PATH"fshaderbg.glsl");
+	game_renderer.initializeChunkShader(ASSET_DIR_PATH"vshaderchunk.glsl", ASSET_DIR_PATH"fshaderchunk.glsl");
 	game_renderer.setCursorMode(0);
 
 	Camera game_camera = Camera();
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+/*
+Size class pool for chunk memory (section storages, mesh pieces and scratch buffers).
+Blocks are rounded up to the next size class (powers of two and 1.5x steps between them) and returned to a free list of that class on release.
+Each class keeps at most 'capacity' free blocks (see setCapacity()), more than that goes back to the heap. reserve() fills a class up front, so streaming does not reach the heap once warm.
+The main thread and all chunk workers allocate and release, each size class has its own lock so allocations of different classes do not wait for each other.
+Counters report how many requests reached the heap and how many were served from the free lists.
+*/
+class MemoryPool
+{
+public:
+
+	template <typename T> static T* allocateArray(size_t count) {
+		return (T*)allocate(count * sizeof(T));
+	}
+
+	static void* allocate(size_t bytes) {
+		int size_class = sizeClassFor(bytes);
+		{
+			std::lock_guard<std::mutex> lock(class_mutexes[size_class]);
+			FreeBlock* block = free_lists[size_class];
+			if (block) {
+				free_lists[size_class] = block->next;
+				free_counts[size_class]--;
+				pool_allocations++;
+				*(int*)block = size_class; // The free list link was stored over the header
+				return (unsigned char*)block + HEADER_SIZE;
+			}
+		}
+		heap_allocations++;
+		unsigned char* raw = new unsigned char[HEADER_SIZE + classSize(size_class)];
+		*(int*)raw = size_class;
+		return raw + HEADER_SIZE;
+	}
+
+	static void release(void* ptr) {
+		if (!ptr)
+			return;
+		unsigned char* raw = (unsigned char*)ptr - HEADER_SIZE;
+		int size_class = *(int*)raw;
+		{
+			std::lock_guard<std::mutex> lock(class_mutexes[size_class]);
+			if (free_counts[size_class] < capacity) {
+				FreeBlock* block = (FreeBlock*)raw;
+				block->next = free_lists[size_class];
+				free_lists[size_class] = block;
+				free_counts[size_class]++;
+				return;
+			}
+		}
+		heap_frees++;
+		delete[] raw;
+	}
+
+	// Maximum number of free blocks kept in each size class. ChunkManager sets it from max_memory_chunks.
+	static void setCapacity(int blocks_per_class) {
+		capacity = blocks_per_class;
+	}
+
+	// Fills the size class of 'bytes' up to 'blocks' free blocks (at most the capacity), so that many allocations of it are served without the heap.
+	static void reserve(size_t bytes, int blocks) {
+		int size_class = sizeClassFor(bytes);
+		std::lock_guard<std::mutex> lock(class_mutexes[size_class]);
+		if (blocks > capacity)
+			blocks = capacity;
+		while (free_counts[size_class] < blocks) {
+			FreeBlock* block = (FreeBlock*)new unsigned char[HEADER_SIZE + classSize(size_class)];
+			block->next = free_lists[size_class];
+			free_lists[size_class] = block;
+			free_counts[size_class]++;
+			reserved_blocks++;
+		}
+	}
+
+	// Gives all free blocks back to the heap.
+	static void trim() {
+		for (int i = 0; i < SIZE_CLASSES; i++) {
+			std::lock_guard<std::mutex> lock(class_mutexes[i]);
+			while (free_lists[i]) {
+				FreeBlock* block = free_lists[i];
+				free_lists[i] = block->next;
+				delete[] (unsigned char*)block;
+			}
+			free_counts[i] = 0;
+		}
+	}
+
+	static unsigned long long getHeapAllocations() {
+		return heap_allocations;
+	}
+
+	static unsigned long long getPoolAllocations() {
+		return pool_allocations;
+	}
+
+	static unsigned long long getHeapFrees() {
+		return heap_frees;
+	}
+
+	// Blocks made by reserve(), not counted in getHeapAllocations()
+	static unsigned long long getReservedBlocks() {
+		return reserved_blocks;
+	}
+
+private:
+
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	// Keeps the returned memory aligned for any type
+	static const int HEADER_SIZE = 16;
+
+	static const int SIZE_CLASSES = 48;
+
+	static inline std::mutex class_mutexes[SIZE_CLASSES];
+
+	static inline FreeBlock* free_lists[SIZE_CLASSES] = {};
+
+	static inline int free_counts[SIZE_CLASSES] = {};
+
+	static inline std::atomic<int> capacity{ 0 };
+
+	static inline std::atomic<unsigned long long> heap_allocations{ 0 };
+
+	static inline std::atomic<unsigned long long> pool_allocations{ 0 };
+
+	static inline std::atomic<unsigned long long> heap_frees{ 0 };
+
+	static inline std::atomic<unsigned long long> reserved_blocks{ 0 };
+
+	// Class 0 is 16 bytes, then 24, 32, 48, 64, 96 ...
+	static size_t classSize(int size_class) {
+		size_t base = (size_t)16 << (size_class / 2);
+		return (size_class % 2) ? base + base / 2 : base;
+	}
+
+	static int sizeClassFor(size_t bytes) {
+		int size_class = 0;
+		while (classSize(size_class) < bytes)
+			size_class++;
+		return size_class;
+	}
+};
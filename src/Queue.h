@@ -1,62 +1,134 @@
 #pragma once
 
-template <typename T> class Queue 
+#include <atomic>
+#include <cstddef>
+
+/*
+Bounded lock-free multi-producer / multi-consumer ring queue (sequence number per cell).
+Any number of threads may enqueue and dequeue at the same time. Nothing is allocated after initialize().
+Each cell's sequence number tells whose turn it is: equal to the position when free for the producer, position + 1 when filled for the consumer.
+enqueue() fails when the queue is full, so size it for the most items which can be pending at once.
+T should be cheap to copy (pointers, small structs).
+*/
+template <typename T> class Queue
 {
 public:
 
 	Queue() {
-		front = rear = nullptr;
+		cells = nullptr;
+		mask = 0;
+	}
+
+	Queue(size_t min_capacity) : Queue() {
+		initialize(min_capacity);
 	}
 
 	~Queue() {
-		T temp;
-		while (!isEmpty())
-			dequeue(temp);
+		delete[] cells;
 	}
 
-	bool isEmpty() const {
-		return front == nullptr && rear == nullptr;
+	Queue(const Queue&) = delete;
+
+	Queue& operator=(const Queue&) = delete;
+
+	// Capacity is rounded up to a power of two. Not thread safe, call before sharing the queue.
+	void initialize(size_t min_capacity) {
+		delete[] cells;
+		size_t capacity = 2;
+		while (capacity < min_capacity)
+			capacity <<= 1;
+		mask = capacity - 1;
+		cells = new Cell[capacity];
+		for (size_t i = 0; i < capacity; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		enqueue_pos.store(0, std::memory_order_relaxed);
+		dequeue_pos.store(0, std::memory_order_relaxed);
 	}
 
-	void enqueue(const T& item) {
-		Node* newNode = new Node;
-		newNode->data = item;
-		newNode->next = nullptr;
+	// Only a hint while other threads are using the queue.
+	bool isEmpty() const {
+		return enqueue_pos.load(std::memory_order_acquire) <= dequeue_pos.load(std::memory_order_acquire);
+	}
 
-		if (isEmpty()) {
-			front = rear = newNode;
-		}
-		else {
-			rear->next = newNode;
-			rear = newNode;
+	bool enqueue(const T& item) {
+		size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;) {
+			cell = &cells[pos & mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			long long diff = (long long)sequence - (long long)pos;
+			if (diff == 0) {
+				if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0) {
+				return false; // Full
+			}
+			else {
+				pos = enqueue_pos.load(std::memory_order_relaxed);
+			}
 		}
+		cell->data = item;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
 	}
 
 	bool dequeue(T& dst) {
-		if (isEmpty())
-			return false;
-
-		Node* temp = front;
-		front = front->next;
-
-		if (front == nullptr)
-			rear = nullptr;
+		return dequeueBatch(&dst, 1) == 1;
+	}
 
-		dst = temp->data;
-		delete temp;
+	// Takes up to 'max_count' items in order with a single claim, returns how many were taken.
+	int dequeueBatch(T* dst, int max_count) {
+		size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+		int count;
+		for (;;) {
+			count = 0;
+			while (count < max_count) {
+				size_t sequence = cells[(pos + count) & mask].sequence.load(std::memory_order_acquire);
+				if ((long long)sequence - (long long)(pos + count + 1) != 0)
+					break;
+				count++;
+			}
+			if (count == 0) {
+				size_t sequence = cells[pos & mask].sequence.load(std::memory_order_acquire);
+				if ((long long)sequence - (long long)(pos + 1) < 0)
+					return 0; // Empty
+				pos = dequeue_pos.load(std::memory_order_relaxed); // Another consumer got it first
+				continue;
+			}
+			if (dequeue_pos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+				break;
+		}
+		for (int i = 0; i < count; i++) {
+			Cell& cell = cells[(pos + i) & mask];
+			dst[i] = cell.data;
+			cell.sequence.store(pos + i + mask + 1, std::memory_order_release);
+		}
+		return count;
+	}
 
-		return true;
+	size_t capacity() const {
+		return mask + 1;
 	}
 
 private:
 
-	struct Node {
+	struct Cell {
+		std::atomic<size_t> sequence;
 		T data;
-		Node* next;
 	};
 
-	Node* front;
+	static const int CACHE_LINE = 64;
+
+	Cell* cells;
+
+	size_t mask;
+
+	// Kept on separate cache lines, producers and consumers do not share them
+	alignas(CACHE_LINE) std::atomic<size_t> enqueue_pos;
+
+	alignas(CACHE_LINE) std::atomic<size_t> dequeue_pos;
 
-	Node* rear;
+	char padding[CACHE_LINE - sizeof(std::atomic<size_t>)];
 
 };
@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+Intrusive doubly linked lists over the chunk slots, every slot is in exactly one of them.
+ChunkManager keeps a list per slot state (free, loading, meshing...), so it only walks the slots which may have work instead of the whole chunk list.
+Moving a slot is constant time and appends it to the end of its new list. Only the owner thread (main thread) should use it.
+To move slots while walking a list, read next() before moving the current one.
+*/
+class SlotLists
+{
+public:
+
+	SlotLists() {
+		next_slot = prev_slot = list_of = nullptr;
+		heads = tails = sizes = nullptr;
+	}
+
+	~SlotLists() {
+		destroy();
+	}
+
+	// All slots start in list 0, in slot order.
+	void initialize(int slots, int lists) {
+		destroy();
+		next_slot = new int[slots];
+		prev_slot = new int[slots];
+		list_of = new int[slots];
+		heads = new int[lists];
+		tails = new int[lists];
+		sizes = new int[lists];
+		for (int i = 0; i < lists; i++) {
+			heads[i] = tails[i] = -1;
+			sizes[i] = 0;
+		}
+		for (int slot = 0; slot < slots; slot++) {
+			list_of[slot] = -1;
+			move(slot, 0);
+		}
+	}
+
+	void destroy() {
+		if (!heads)
+			return;
+		delete[] next_slot;
+		delete[] prev_slot;
+		delete[] list_of;
+		delete[] heads;
+		delete[] tails;
+		delete[] sizes;
+		next_slot = prev_slot = list_of = nullptr;
+		heads = tails = sizes = nullptr;
+	}
+
+	// Moves 'slot' to the end of 'list', nothing happens if it is already there.
+	void move(int slot, int list) {
+		if (list_of[slot] == list)
+			return;
+		if (list_of[slot] >= 0)
+			unlink(slot);
+		list_of[slot] = list;
+		prev_slot[slot] = tails[list];
+		next_slot[slot] = -1;
+		if (tails[list] >= 0)
+			next_slot[tails[list]] = slot;
+		else
+			heads[list] = slot;
+		tails[list] = slot;
+		sizes[list]++;
+	}
+
+	int listOf(int slot) const {
+		return list_of[slot];
+	}
+
+	// First slot of 'list', or -1 if it is empty.
+	int first(int list) const {
+		return heads[list];
+	}
+
+	// The slot after 'slot' in its list, or -1.
+	int next(int slot) const {
+		return next_slot[slot];
+	}
+
+	int size(int list) const {
+		return sizes[list];
+	}
+
+private:
+
+	int* next_slot;
+
+	int* prev_slot;
+
+	int* list_of;
+
+	int* heads;
+
+	int* tails;
+
+	int* sizes;
+
+	void unlink(int slot) {
+		int list = list_of[slot];
+		if (prev_slot[slot] >= 0)
+			next_slot[prev_slot[slot]] = next_slot[slot];
+		else
+			heads[list] = next_slot[slot];
+		if (next_slot[slot] >= 0)
+			prev_slot[next_slot[slot]] = prev_slot[slot];
+		else
+			tails[list] = prev_slot[slot];
+		sizes[list]--;
+	}
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vector>
+
+#include "BlockTicks.h"
+
+/*
+Tickable blocks of one chunk. Entries are stored densely (tick iteration and saving use data() / size()),
+and an open addressing hash table maps local positions to entry indices, so find, add and remove are O(1).
+Removing swaps the last entry into the hole, so entry order is not kept and pointers from find() are only valid until the next add/remove.
+*/
+class TickableBlockList
+{
+public:
+
+	TickableBlockList() {
+		mask = 0;
+	}
+
+	TickableBlock* find(int x, int y, int z) {
+		if (blocks.empty())
+			return nullptr;
+		int slot = findSlot(x, y, z);
+		return (table[slot] < 0) ? nullptr : &blocks[table[slot]];
+	}
+
+	// Adds 'tb', or replaces the entry already at its position.
+	void add(const TickableBlock& tb) {
+		if ((blocks.size() + 1) * 2 > table.size())
+			grow();
+		int slot = findSlot(tb.x, tb.y, tb.z);
+		if (table[slot] >= 0) {
+			blocks[table[slot]] = tb;
+			return;
+		}
+		table[slot] = (int)blocks.size();
+		blocks.push_back(tb);
+	}
+
+	bool remove(int x, int y, int z) {
+		if (blocks.empty())
+			return false;
+		int slot = findSlot(x, y, z);
+		int index = table[slot];
+		if (index < 0)
+			return false;
+		removeSlot(slot);
+
+		// Move the last entry into the hole
+		int last = (int)blocks.size() - 1;
+		if (index != last) {
+			blocks[index] = blocks[last];
+			table[findSlot(blocks[index].x, blocks[index].y, blocks[index].z)] = index;
+		}
+		blocks.pop_back();
+		return true;
+	}
+
+	void clear() {
+		blocks.clear();
+		for (size_t i = 0; i < table.size(); i++)
+			table[i] = -1;
+	}
+
+	size_t size() const {
+		return blocks.size();
+	}
+
+	TickableBlock* data() {
+		return blocks.data();
+	}
+
+	TickableBlock* begin() {
+		return blocks.data();
+	}
+
+	TickableBlock* end() {
+		return blocks.data() + blocks.size();
+	}
+
+private:
+
+	std::vector<TickableBlock> blocks;
+
+	// Entry index for each slot, -1 if empty. Power of two size, at most half full.
+	std::vector<int> table;
+
+	int mask;
+
+	static int hash(int x, int y, int z) {
+		unsigned int key = ((unsigned int)y << 8) | ((unsigned int)(x & 15) << 4) | (unsigned int)(z & 15);
+		key *= 2654435761u;
+		return (int)(key >> 8);
+	}
+
+	// The slot holding (x, y, z), or the empty slot where it would be added.
+	int findSlot(int x, int y, int z) const {
+		int slot = hash(x, y, z) & mask;
+		while (table[slot] >= 0) {
+			const TickableBlock& tb = blocks[table[slot]];
+			if (tb.x == x && tb.y == y && tb.z == z)
+				break;
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	// Backward shift deletion, so probe sequences stay unbroken
+	void removeSlot(int slot) {
+		int hole = slot;
+		int next = (slot + 1) & mask;
+		while (table[next] >= 0) {
+			const TickableBlock& tb = blocks[table[next]];
+			int home = hash(tb.x, tb.y, tb.z) & mask;
+			if (((next - home) & mask) >= ((next - hole) & mask)) {
+				table[hole] = table[next];
+				hole = next;
+			}
+			next = (next + 1) & mask;
+		}
+		table[hole] = -1;
+	}
+
+	void grow() {
+		size_t capacity = table.empty() ? 64 : table.size() * 2;
+		table.assign(capacity, -1);
+		mask = (int)capacity - 1;
+		for (size_t i = 0; i < blocks.size(); i++)
+			table[findSlot(blocks[i].x, blocks[i].y, blocks[i].z)] = (int)i;
+	}
+};
@@ -0,0 +1,53 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "../src/ChunkThread.h"
+#include "../src/ChunkGenerator.h"
+
+/*
+Chunk shape test, generates chunks of every compiled shape (see withChunkShape()) with the compiled kernel and with the runtime ChunkShape<0, 0> kernel.
+Both have to give the same blocks and tickable blocks. Build it with -DBUILD_TESTS=ON and run it with ctest.
+*/
+
+static bool sameTickableBlocks(TickableBlockList& a, TickableBlockList& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++) {
+		const TickableBlock& ta = a.data()[i];
+		const TickableBlock& tb = b.data()[i];
+		if (ta.block_id != tb.block_id || ta.x != tb.x || ta.y != tb.y || ta.z != tb.z)
+			return false;
+	}
+	return true;
+}
+
+int main()
+{
+	int seeds[16];
+	for (int i = 0; i < 16; i++)
+		seeds[i] = 1000003 * (i + 1) % 65536;
+	const int workers[CHUNK_STAGES] = { 0, 0, 0 };
+	chunk_thread::initManagerThread("test", "", seeds, workers);
+
+	const int shapes[][2] = { { 16, 512 }, { 16, 256 }, { 32, 32 } };
+	ChunkTimeStamp cts = { 0, 0, 600.0f };
+	int failures = 0;
+	for (const int* shape : shapes) {
+		int size = shape[0], height = shape[1];
+		std::vector<unsigned short int> compiled(size * size * height), runtime(size * size * height);
+		bool same = true;
+		for (int i = 0; i < 9 && same; i++) {
+			int base_x = (i / 3 - 1) * size;
+			int base_z = (i % 3 - 1) * size;
+			TickableBlockList compiled_ticks, runtime_ticks;
+			generateChunk(compiled.data(), size, height, base_x, base_z, cts, &compiled_ticks);
+			generateChunk(runtime.data(), ChunkShape<0, 0>(size, height), base_x, base_z, cts, &runtime_ticks);
+			same = memcmp(compiled.data(), runtime.data(), compiled.size() * sizeof(unsigned short int)) == 0 && sameTickableBlocks(compiled_ticks, runtime_ticks);
+		}
+		printf("%dx%d %s\n", size, height, same ? "OK" : "DIFFERENT");
+		if (!same)
+			failures++;
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include "../bench/Headless.h"
+#include "../src/ChunkManager.h"
+
+/*
+Headless stress test of the chunk workers and the chunk state: 8 workers on a small memory, the player jumps between spots every 40 frames
+(loads, saves and unloads all the time) and edits blocks around it every frame (urgent remeshes, section copies and their reclaiming).
+Each edit has to read back right away. Build it with -DBUILD_TESTS=ON -DENABLE_TSAN=ON to run it under ThreadSanitizer, run it with ctest.
+Usage: ChunkStressTest [workers] [frames]
+*/
+int main(int argc, char** argv)
+{
+	int workers = argc > 1 ? atoi(argv[1]) : 8;
+	int frames = argc > 2 ? atoi(argv[2]) : 1000;
+	if (workers < 1 || frames < 1) {
+		printf("usage: ChunkStressTest [workers >= 1] [frames >= 1]\n");
+		return 1;
+	}
+
+	headless::installHeadlessGL();
+	std::string datadir = headless::makeWorldDirectory("test");
+	int render_distance = 4;
+	ChunkManager manager;
+	manager.initialize(datadir.c_str(), "test", (render_distance * 2 + 1) * (render_distance * 2 + 1), render_distance, "stress", workers);
+	ChunkTimeStamp now = { 0, 5, 600.0f };
+
+	unsigned int random = 12345;
+	auto next = [&random]() {
+		random = random * 1103515245 + 12345;
+		return (int)(random >> 8 & 0xffff);
+	};
+	int x = 8, z = 8;
+	long edits = 0, errors = 0;
+	for (int frame = 0; frame < frames; frame++) {
+		if (frame % 40 == 0) {
+			x = next() % 5 * 48 - 96;
+			z = next() % 5 * 48 - 96;
+		}
+		else
+			x += next() % 3 - 1;
+		manager.updatePlayer(x, 100, z, (float)(frame % 360));
+		manager.update(now);
+		manager.updateRenderList(x, 100, z);
+
+		for (int i = 0; i < 4; i++) {
+			int bx = x + next() % 48 - 24, by = next() % 120 + 8, bz = z + next() % 48 - 24;
+			unsigned short int block = (unsigned short int)(next() % 6), read;
+			if (!manager.getBlock(bx, by, bz, read))
+				continue; // Not loaded yet
+			if (manager.setBlock(bx, by, bz, block)) {
+				edits++;
+				if (!manager.getBlock(bx, by, bz, read) || read != block)
+					errors++;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+	manager.destroy();
+
+	printf("workers: %d, frames: %d, edits: %ld, errors: %ld, dropped jobs: %llu, merged requests: %llu, stale meshes: %llu\n", workers, frames, edits, errors,
+		chunk_thread::getDroppedJobs(), chunk_thread::getMergedRequests(), chunk_thread::getStaleMeshes());
+	return (errors || edits == 0) ? 1 : 0;
+}
@@ -0,0 +1,43 @@
+#include <cstdio>
+#include "../src/ChunkThread.h"
+
+/*
+Golden mesh test, meshes the chunks around chunk (0, 0) of a fixed seed with the bit plane face culling and with the per block reference culling (see chunk_thread::setBitPlaneCulling()).
+Both have to give the vertex buffers of the mesher before the bit plane culling (commit 31281e0), with greedy meshing on and off. Build it with -DBUILD_TESTS=ON and run it with ctest.
+*/
+
+// Recorded with the mesher of commit 31281e0 (g++, x86-64), same seeds, radius 3 and one pass
+struct GoldenMesh
+{
+	bool greedy;
+	size_t vertices;
+	unsigned long long vertex_hash;
+};
+const GoldenMesh golden_meshes[] = {
+	{ true, 73240, 0x4f1a38d6bfb7c519ull },
+	{ false, 102236, 0x93c801f9f2810049ull },
+};
+
+int main()
+{
+	int seeds[16];
+	for (int i = 0; i < 16; i++)
+		seeds[i] = 1000003 * (i + 1) % 65536;
+	const int workers[CHUNK_STAGES] = { 0, 0, 0 };
+	chunk_thread::initManagerThread("test", "", seeds, workers);
+
+	int failures = 0;
+	for (const GoldenMesh& golden : golden_meshes) {
+		chunk_thread::setGreedyMeshing(golden.greedy);
+		for (int bit_planes = 1; bit_planes >= 0; bit_planes--) {
+			chunk_thread::setBitPlaneCulling(bit_planes);
+			MeshBenchmarkResult result = chunk_thread::benchmarkMeshing(3, 1);
+			bool same = result.vertices == golden.vertices && result.vertex_hash == golden.vertex_hash;
+			printf("%-8s %-10s chunks: %d, vertices: %zu (%016llx), golden: %zu (%016llx) %s\n", golden.greedy ? "greedy" : "per-face", bit_planes ? "bit planes" : "per block",
+				result.chunks, result.vertices, result.vertex_hash, golden.vertices, golden.vertex_hash, same ? "OK" : "DIFFERENT");
+			if (!same)
+				failures++;
+		}
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "../src/Queue.h"
+
+/*
+Stress test of Queue<T> with several producers and consumers on a small queue, so it is full and empty all the time.
+Every item has to come out exactly once, and the items of one producer in the order it enqueued them (as seen by each consumer).
+Build it with -DBUILD_TESTS=ON -DENABLE_TSAN=ON to run it under ThreadSanitizer, run it with ctest.
+*/
+
+// Item 'index' of 'producer'
+static long long makeItem(int producer, long long index)
+{
+	return (long long)producer << 40 | index;
+}
+
+// Returns the number of errors
+static int stress(int producers, int consumers, int batch, size_t capacity, long long items_per_producer)
+{
+	Queue<long long> queue(capacity);
+	std::vector<std::atomic<unsigned char>> received((size_t)producers * items_per_producer);
+	std::atomic<long long> taken{ 0 };
+	std::atomic<int> errors{ 0 };
+	long long total = producers * items_per_producer;
+
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; p++) {
+		threads.emplace_back([&, p]() {
+			for (long long i = 0; i < items_per_producer; i++)
+				while (!queue.enqueue(makeItem(p, i)))
+					std::this_thread::yield();
+		});
+	}
+	for (int c = 0; c < consumers; c++) {
+		threads.emplace_back([&]() {
+			std::vector<long long> last(producers, -1);
+			long long items[64];
+			while (taken.load() < total) {
+				int count = queue.dequeueBatch(items, batch);
+				if (count == 0) {
+					std::this_thread::yield();
+					continue;
+				}
+				for (int i = 0; i < count; i++) {
+					int producer = (int)(items[i] >> 40);
+					long long index = items[i] & ((1LL << 40) - 1);
+					if (producer >= producers || index >= items_per_producer || index <= last[producer]) {
+						errors++;
+						continue;
+					}
+					last[producer] = index;
+					if (received[(size_t)producer * items_per_producer + index].fetch_add(1) != 0)
+						errors++; // Twice
+				}
+				taken += count;
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	for (size_t i = 0; i < received.size(); i++)
+		if (received[i].load() != 1)
+			errors++;
+	if (!queue.isEmpty())
+		errors++;
+	printf("producers: %d, consumers: %d, batch: %2d, capacity: %4zu, items: %lld, errors: %d\n", producers, consumers, batch, queue.capacity(), total, errors.load());
+	return errors;
+}
+
+int main(int argc, char** argv)
+{
+	long long items = argc > 1 ? atoll(argv[1]) : 20000;
+	int errors = 0;
+	for (int producers : { 1, 2, 4 })
+		for (int consumers : { 1, 2, 4 })
+			for (int batch : { 1, 8 })
+				errors += stress(producers, consumers, batch, 8, items);
+	errors += stress(4, 4, 64, 1024, items);
+	return errors ? 1 : 0;
+}
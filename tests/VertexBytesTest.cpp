@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include "../bench/Headless.h"
+#include "../src/ChunkManager.h"
+
+/*
+Byte counter test of the chunk meshes, streams in the world around the player without a window and counts the bytes sent to the GPU (see bench/Headless.h).
+Compares them with the old vertex format: 6 floats (24 bytes) per vertex and 6 vertices per quad, without an index buffer. The packed format has to take at most a quarter of that.
+Build it with -DBUILD_TESTS=ON, run it with ctest.
+*/
+int main()
+{
+	headless::installHeadlessGL();
+	std::string datadir = headless::makeWorldDirectory("test");
+	int render_distance = 4;
+	ChunkManager manager;
+	manager.initialize(datadir.c_str(), "test", (render_distance * 2 + 1) * (render_distance * 2 + 1) * 3, render_distance, "vertex bytes");
+	ChunkTimeStamp now = { 0, 5, 600.0f };
+
+	// Until every chunk within the render distance has a mesh
+	int in_range = render_distance * render_distance * 2 + render_distance * 2 + 1;
+	int meshed = 0;
+	size_t vertices = 0;
+	while (meshed < in_range) {
+		manager.updatePlayer(8, 100, 8);
+		manager.update(now);
+		manager.updateRenderList(8, 100, 8);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		manager.getMeshReport(meshed, vertices);
+	}
+	manager.destroy();
+
+	size_t quads = vertices / 4;
+	unsigned long long packed = vertices * sizeof(ChunkVertex);
+	unsigned long long old = quads * 6 * 6 * sizeof(float);
+	unsigned long long sent = headless::vertex_bytes + headless::index_bytes;
+	printf("chunks: %d, quads: %zu, vertex size: %zu bytes\n", meshed, quads, sizeof(ChunkVertex));
+	printf("meshes in VRAM: %llu bytes of vertices and %llu bytes of shared indices, old format: %llu bytes (%.2fx)\n", packed, (unsigned long long)headless::index_bytes,
+		old, (double)old / (packed + headless::index_bytes));
+	printf("sent to the GPU: %llu bytes in %llu vertex uploads (%.2fx less than the old format)\n", sent, (unsigned long long)headless::vertex_uploads, (double)old / sent);
+
+	bool ok = sizeof(ChunkVertex) == 8 && vertices % 4 == 0 && quads > 0 && headless::vertex_bytes >= packed && (packed + headless::index_bytes) * 4 <= old;
+	printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}